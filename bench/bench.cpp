@@ -0,0 +1,559 @@
+#include "libcpp-http-client.hpp"
+#include "loopback_server.hpp"
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <new>
+
+using namespace lklibs;
+using namespace lklibs::bench;
+
+/*
+ * Allocations are counted for operator new (library and standard library) and for the
+ * allocations made by curl itself through curl_global_init_mem. Server threads are excluded.
+ */
+static std::atomic<uint64_t> allocationCount{0};
+static thread_local bool isServerThread = false;
+
+static void countAllocation()
+{
+    if (!isServerThread)
+    {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void* operator new(const size_t size)
+{
+    countAllocation();
+
+    if (void* pointer = std::malloc(size == 0 ? 1 : size))
+    {
+        return pointer;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+static void* countingMalloc(const size_t size)
+{
+    countAllocation();
+
+    return std::malloc(size);
+}
+
+static void* countingCalloc(const size_t count, const size_t size)
+{
+    countAllocation();
+
+    return std::calloc(count, size);
+}
+
+static void* countingRealloc(void* pointer, const size_t size)
+{
+    countAllocation();
+
+    return std::realloc(pointer, size);
+}
+
+static char* countingStrdup(const char* source)
+{
+    countAllocation();
+
+    return strdup(source);
+}
+
+static LoopbackServer& server()
+{
+    static LoopbackServer instance([]
+    {
+        isServerThread = true;
+    });
+
+    return instance;
+}
+
+/**
+ * @brief Collects per-request latencies and allocations and reports them as benchmark counters
+ */
+class Recorder
+{
+public:
+    explicit Recorder(benchmark::State& state) : state(state)
+    {
+        latencies.reserve(100000);
+
+        startAllocations = allocationCount.load();
+    }
+
+    ~Recorder()
+    {
+        const auto allocations = allocationCount.load() - startAllocations;
+
+        std::sort(latencies.begin(), latencies.end());
+
+        state.counters["requests_per_second"] = benchmark::Counter(static_cast<double>(requests), benchmark::Counter::kIsRate);
+        state.counters["allocations_per_request"] = requests == 0 ? 0 : static_cast<double>(allocations) / static_cast<double>(requests);
+        state.counters["p50_us"] = percentile(0.50);
+        state.counters["p99_us"] = percentile(0.99);
+    }
+
+    Recorder(const Recorder&) = delete;
+
+    Recorder& operator=(const Recorder&) = delete;
+
+    template <typename Function>
+    void measure(const size_t requestCount, Function&& function)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        function();
+
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        latencies.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+
+        requests += requestCount;
+    }
+
+private:
+    benchmark::State& state;
+    std::vector<double> latencies;
+    size_t requests = 0;
+    uint64_t startAllocations = 0;
+
+    [[nodiscard]] double percentile(const double ratio) const
+    {
+        if (latencies.empty())
+        {
+            return 0;
+        }
+
+        return latencies[std::min(latencies.size() - 1, static_cast<size_t>(ratio * static_cast<double>(latencies.size())))];
+    }
+};
+
+static void checkResult(benchmark::State& state, const HttpResult& result)
+{
+    if (!result.succeed)
+    {
+        state.SkipWithError(result.errorMessage.c_str());
+    }
+}
+
+static void smallGet(benchmark::State& state)
+{
+    const auto url = server().url("/bytes/64");
+
+    Recorder recorder(state);
+
+    for (auto _ : state)
+    {
+        recorder.measure(1, [&]
+        {
+            HttpRequest httpRequest(url);
+
+            checkResult(state, httpRequest.send().get());
+        });
+    }
+}
+
+static void smallGetWithoutConnectionPool(benchmark::State& state)
+{
+    const auto url = server().url("/bytes/64");
+
+    Recorder recorder(state);
+
+    for (auto _ : state)
+    {
+        recorder.measure(1, [&]
+        {
+            HttpRequest httpRequest(url);
+
+            checkResult(state, httpRequest.setConnectionPool(nullptr).send().get());
+        });
+    }
+}
+
+static void smallGetWithExecutor(benchmark::State& state)
+{
+    const auto url = server().url("/bytes/64");
+
+    ThreadPoolExecutor executor(1);
+
+    Recorder recorder(state);
+
+    for (auto _ : state)
+    {
+        recorder.measure(1, [&]
+        {
+            HttpRequest httpRequest(url);
+
+            checkResult(state, httpRequest.send(executor).get());
+        });
+    }
+}
+
+static void smallGetWithHttpClient(benchmark::State& state)
+{
+    const auto url = server().url("/bytes/64");
+
+    HttpClient client;
+
+    Recorder recorder(state);
+
+    for (auto _ : state)
+    {
+        recorder.measure(1, [&]
+        {
+            checkResult(state, client.send(HttpRequest(url)).get());
+        });
+    }
+}
+
+static void largeDownload(benchmark::State& state)
+{
+    const auto url = server().url("/bytes/" + std::to_string(state.range(0)));
+
+    Recorder recorder(state);
+
+    for (auto _ : state)
+    {
+        recorder.measure(1, [&]
+        {
+            HttpRequest httpRequest(url);
+
+            checkResult(state, httpRequest.returnAsBinary().send().get());
+        });
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+static void largeDownloadIntoBuffer(benchmark::State& state)
+{
+    const auto url = server().url("/bytes/" + std::to_string(state.range(0)));
+
+    std::vector<unsigned char> buffer(static_cast<size_t>(state.range(0)));
+
+    Recorder recorder(state);
+
+    for (auto _ : state)
+    {
+        recorder.measure(1, [&]
+        {
+            HttpRequest httpRequest(url);
+
+            checkResult(state, httpRequest.setResponseBuffer(buffer.data(), buffer.size()).send().get());
+        });
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+static void largeDownloadWithBufferPool(benchmark::State& state)
+{
+    const auto url = server().url("/bytes/" + std::to_string(state.range(0)));
+
+    auto pool = std::make_shared<ResponseBufferPool>(256 * 1024 * 1024);
+
+    Recorder recorder(state);
+
+    for (auto _ : state)
+    {
+        recorder.measure(1, [&]
+        {
+            HttpRequest httpRequest(url);
+
+            checkResult(state, httpRequest.returnAsBinary().setResponseBufferPool(pool).send().get());
+        });
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+static void postUpload(benchmark::State& state)
+{
+    const auto url = server().url("/upload");
+    const std::string payload(static_cast<size_t>(state.range(0)), 'p');
+
+    Recorder recorder(state);
+
+    for (auto _ : state)
+    {
+        recorder.measure(1, [&]
+        {
+            HttpRequest httpRequest(url);
+
+            checkResult(state, httpRequest.setMethod(HttpMethod::POST).setPayload(payload).send().get());
+        });
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+static void postUploadStream(benchmark::State& state)
+{
+    const auto url = server().url("/upload");
+    const std::string payload(static_cast<size_t>(state.range(0)), 'p');
+
+    Recorder recorder(state);
+
+    for (auto _ : state)
+    {
+        recorder.measure(1, [&]
+        {
+            size_t position = 0;
+
+            HttpRequest httpRequest(url);
+
+            httpRequest
+                .setMethod(HttpMethod::POST)
+                .setPayloadStream([&](char* buffer, const size_t bufferSize)
+                {
+                    const auto length = std::min(bufferSize, payload.size() - position);
+
+                    std::memcpy(buffer, payload.data() + position, length);
+
+                    position += length;
+
+                    return length;
+                }, static_cast<long long>(payload.size()));
+
+            checkResult(state, httpRequest.send().get());
+        });
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+static void fanOut(benchmark::State& state)
+{
+    const auto url = server().url("/bytes/64");
+    const auto requestCount = static_cast<size_t>(state.range(0));
+
+    Recorder recorder(state);
+
+    for (auto _ : state)
+    {
+        recorder.measure(requestCount, [&]
+        {
+            std::vector<HttpRequest> httpRequests(requestCount, HttpRequest(url));
+            std::vector<std::future<HttpResult>> futures;
+
+            for (auto& httpRequest : httpRequests)
+            {
+                futures.push_back(httpRequest.send());
+            }
+
+            for (auto& future : futures)
+            {
+                checkResult(state, future.get());
+            }
+        });
+    }
+}
+
+static void fanOutWithHttpClient(benchmark::State& state)
+{
+    const auto url = server().url("/bytes/64");
+    const auto requestCount = static_cast<size_t>(state.range(0));
+
+    HttpClient client;
+
+    Recorder recorder(state);
+
+    for (auto _ : state)
+    {
+        recorder.measure(requestCount, [&]
+        {
+            std::vector<std::future<HttpResult>> futures;
+
+            for (size_t i = 0; i < requestCount; i++)
+            {
+                futures.push_back(client.send(HttpRequest(url)));
+            }
+
+            for (auto& future : futures)
+            {
+                checkResult(state, future.get());
+            }
+        });
+    }
+}
+
+static void fanOutWithSendAll(benchmark::State& state)
+{
+    const auto url = server().url("/bytes/64");
+    const auto requestCount = static_cast<size_t>(state.range(0));
+
+    HttpClient client;
+
+    Recorder recorder(state);
+
+    for (auto _ : state)
+    {
+        recorder.measure(requestCount, [&]
+        {
+            auto batch = client.sendAll(std::vector<HttpRequest>(requestCount, HttpRequest(url)));
+
+            while (auto completed = batch.next())
+            {
+                checkResult(state, completed->result);
+            }
+        });
+    }
+}
+
+static void fanOutWithCallback(benchmark::State& state)
+{
+    const auto url = server().url("/bytes/64");
+    const auto requestCount = static_cast<size_t>(state.range(0));
+
+    HttpClient client;
+
+    Recorder recorder(state);
+
+    for (auto _ : state)
+    {
+        recorder.measure(requestCount, [&]
+        {
+            std::mutex mutex;
+            std::condition_variable completed;
+            size_t pending = requestCount;
+            size_t failed = 0;
+
+            for (size_t i = 0; i < requestCount; i++)
+            {
+                client.send(HttpRequest(url), [&](HttpResult&& result)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    failed += result.succeed ? 0 : 1;
+
+                    if (--pending == 0)
+                    {
+                        completed.notify_one();
+                    }
+                });
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+
+            completed.wait(lock, [&]
+            {
+                return pending == 0;
+            });
+
+            if (failed > 0)
+            {
+                state.SkipWithError("Request failed");
+            }
+        });
+    }
+}
+
+static void streamingCallback(benchmark::State& state)
+{
+    const auto url = server().url("/bytes/" + std::to_string(state.range(0)));
+
+    Recorder recorder(state);
+
+    for (auto _ : state)
+    {
+        recorder.measure(1, [&]
+        {
+            size_t received = 0;
+
+            HttpRequest httpRequest(url);
+
+            httpRequest.onDataReceived([&](const unsigned char*, const size_t dataLength)
+            {
+                received += dataLength;
+            });
+
+            checkResult(state, httpRequest.send().get());
+
+            benchmark::DoNotOptimize(received);
+        });
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+/*
+ * HTTP/2 is not served by the loopback server. Set LIBCPP_HTTP_CLIENT_BENCH_H2_URL to the URL of
+ * an h2c server (e.g. "nghttpd --no-tls -d ./www 8080") to run these benchmarks too.
+ */
+static void http2FanOutWithHttpClient(benchmark::State& state, const std::string& url)
+{
+    const auto requestCount = static_cast<size_t>(state.range(0));
+
+    HttpClient client;
+
+    Recorder recorder(state);
+
+    for (auto _ : state)
+    {
+        recorder.measure(requestCount, [&]
+        {
+            std::vector<std::future<HttpResult>> futures;
+
+            for (size_t i = 0; i < requestCount; i++)
+            {
+                futures.push_back(client.send(HttpRequest(url).setHttpVersion(HttpVersion::HTTP_2_PRIOR_KNOWLEDGE)));
+            }
+
+            for (auto& future : futures)
+            {
+                checkResult(state, future.get());
+            }
+        });
+    }
+}
+
+BENCHMARK(smallGet)->UseRealTime();
+BENCHMARK(smallGetWithoutConnectionPool)->UseRealTime();
+BENCHMARK(smallGetWithExecutor)->UseRealTime();
+BENCHMARK(smallGetWithHttpClient)->UseRealTime();
+BENCHMARK(largeDownload)->Arg(1 << 20)->Arg(16 << 20)->UseRealTime();
+BENCHMARK(largeDownloadIntoBuffer)->Arg(1 << 20)->Arg(16 << 20)->UseRealTime();
+BENCHMARK(largeDownloadWithBufferPool)->Arg(1 << 20)->Arg(16 << 20)->UseRealTime();
+BENCHMARK(postUpload)->Arg(64 << 10)->Arg(4 << 20)->UseRealTime();
+BENCHMARK(postUploadStream)->Arg(64 << 10)->Arg(4 << 20)->UseRealTime();
+BENCHMARK(fanOut)->Arg(100)->UseRealTime();
+BENCHMARK(fanOutWithHttpClient)->Arg(100)->Arg(1000)->UseRealTime();
+BENCHMARK(fanOutWithSendAll)->Arg(100)->Arg(1000)->UseRealTime();
+BENCHMARK(fanOutWithCallback)->Arg(100)->Arg(1000)->UseRealTime();
+BENCHMARK(streamingCallback)->Arg(1 << 20)->UseRealTime();
+
+int main(int argc, char** argv)
+{
+    curl_global_init_mem(CURL_GLOBAL_DEFAULT, countingMalloc, std::free, countingRealloc, countingStrdup, countingCalloc);
+
+    if (const char* http2Url = std::getenv("LIBCPP_HTTP_CLIENT_BENCH_H2_URL"))
+    {
+        benchmark::RegisterBenchmark("http2FanOutWithHttpClient", http2FanOutWithHttpClient, std::string(http2Url))->Arg(100)->UseRealTime();
+    }
+
+    benchmark::Initialize(&argc, argv);
+
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    return 0;
+}
@@ -0,0 +1,300 @@
+#ifndef LIBCPP_HTTP_CLIENT_LOOPBACK_SERVER_HPP
+#define LIBCPP_HTTP_CLIENT_LOOPBACK_SERVER_HPP
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace lklibs::bench
+{
+    /**
+     * @brief Minimal HTTP/1.1 server on the loopback interface, so that the benchmarks measure the
+     * overhead of the library instead of the network
+     *
+     * GET /bytes/{n} returns n bytes, any other request (including uploads) returns "ok".
+     * Connections are kept alive and every connection is served by its own thread.
+     */
+    class LoopbackServer
+    {
+    public:
+        /**
+         * @param onThreadStart: Called at the start of every server thread (e.g. to exclude them from allocation counting)
+         */
+        explicit LoopbackServer(std::function<void()> onThreadStart = [] {}) : onThreadStart(std::move(onThreadStart))
+        {
+            listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+
+            const int enable = 1;
+
+            setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+            sockaddr_in address{};
+
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = 0;
+
+            bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+            listen(listenSocket, 1024);
+
+            socklen_t length = sizeof(address);
+
+            getsockname(listenSocket, reinterpret_cast<sockaddr*>(&address), &length);
+
+            serverPort = ntohs(address.sin_port);
+
+            acceptThread = std::thread([this]
+            {
+                acceptConnections();
+            });
+        }
+
+        ~LoopbackServer()
+        {
+            stopping = true;
+
+            shutdown(listenSocket, SHUT_RDWR);
+            close(listenSocket);
+
+            acceptThread.join();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                for (const int clientSocket : clientSockets)
+                {
+                    shutdown(clientSocket, SHUT_RDWR);
+                }
+            }
+
+            for (auto& connectionThread : connectionThreads)
+            {
+                connectionThread.join();
+            }
+        }
+
+        LoopbackServer(const LoopbackServer&) = delete;
+
+        LoopbackServer& operator=(const LoopbackServer&) = delete;
+
+        [[nodiscard]] std::string url(const std::string& path) const
+        {
+            return "http://127.0.0.1:" + std::to_string(serverPort) + path;
+        }
+
+    private:
+        std::function<void()> onThreadStart;
+        int listenSocket = -1;
+        int serverPort = 0;
+        std::atomic<bool> stopping{false};
+        std::thread acceptThread;
+        std::mutex mutex;
+        std::vector<int> clientSockets;
+        std::vector<std::thread> connectionThreads;
+
+        void acceptConnections()
+        {
+            onThreadStart();
+
+            while (!stopping)
+            {
+                const int clientSocket = accept(listenSocket, nullptr, nullptr);
+
+                if (clientSocket < 0)
+                {
+                    continue;
+                }
+
+                const int enable = 1;
+
+                setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+                std::lock_guard<std::mutex> lock(mutex);
+
+                clientSockets.push_back(clientSocket);
+
+                connectionThreads.emplace_back([this, clientSocket]
+                {
+                    onThreadStart();
+
+                    serve(clientSocket);
+
+                    close(clientSocket);
+                });
+            }
+        }
+
+        static bool sendAll(const int clientSocket, const char* data, size_t length)
+        {
+            while (length > 0)
+            {
+                const auto sent = send(clientSocket, data, length, MSG_NOSIGNAL);
+
+                if (sent <= 0)
+                {
+                    return false;
+                }
+
+                data += sent;
+                length -= static_cast<size_t>(sent);
+            }
+
+            return true;
+        }
+
+        static std::string headerValue(const std::string& head, const std::string& name)
+        {
+            auto position = head.find("\r\n" + name + ":");
+
+            if (position == std::string::npos)
+            {
+                return "";
+            }
+
+            position += name.size() + 3;
+
+            const auto end = head.find("\r\n", position);
+
+            while (position < end && head[position] == ' ')
+            {
+                position++;
+            }
+
+            return head.substr(position, end - position);
+        }
+
+        static const std::string& payload()
+        {
+            static const std::string data(64 * 1024 * 1024, 'x');
+
+            return data;
+        }
+
+        void serve(const int clientSocket)
+        {
+            std::string buffer;
+            char chunk[64 * 1024];
+
+            auto receive = [&]
+            {
+                const auto received = recv(clientSocket, chunk, sizeof(chunk), 0);
+
+                if (received <= 0)
+                {
+                    return false;
+                }
+
+                buffer.append(chunk, static_cast<size_t>(received));
+
+                return true;
+            };
+
+            while (!stopping)
+            {
+                size_t headEnd;
+
+                while ((headEnd = buffer.find("\r\n\r\n")) == std::string::npos)
+                {
+                    if (!receive())
+                    {
+                        return;
+                    }
+                }
+
+                const auto head = buffer.substr(0, headEnd + 2);
+
+                buffer.erase(0, headEnd + 4);
+
+                if (headerValue(head, "Expect") == "100-continue")
+                {
+                    static const char continueResponse[] = "HTTP/1.1 100 Continue\r\n\r\n";
+
+                    sendAll(clientSocket, continueResponse, sizeof(continueResponse) - 1);
+                }
+
+                if (headerValue(head, "Transfer-Encoding") == "chunked")
+                {
+                    while (true)
+                    {
+                        size_t lineEnd;
+
+                        while ((lineEnd = buffer.find("\r\n")) == std::string::npos)
+                        {
+                            if (!receive())
+                            {
+                                return;
+                            }
+                        }
+
+                        const auto chunkSize = std::stoul(buffer.substr(0, lineEnd), nullptr, 16);
+
+                        while (buffer.size() < lineEnd + 2 + chunkSize + 2)
+                        {
+                            if (!receive())
+                            {
+                                return;
+                            }
+                        }
+
+                        buffer.erase(0, lineEnd + 2 + chunkSize + 2);
+
+                        if (chunkSize == 0)
+                        {
+                            break;
+                        }
+                    }
+                }
+                else
+                {
+                    const auto contentLength = headerValue(head, "Content-Length");
+
+                    size_t remaining = contentLength.empty() ? 0 : std::stoul(contentLength);
+
+                    while (remaining > 0)
+                    {
+                        if (buffer.empty() && !receive())
+                        {
+                            return;
+                        }
+
+                        const auto consumed = std::min(remaining, buffer.size());
+
+                        buffer.erase(0, consumed);
+
+                        remaining -= consumed;
+                    }
+                }
+
+                const auto pathStart = head.find(' ') + 1;
+                const auto path = head.substr(pathStart, head.find(' ', pathStart) - pathStart);
+
+                size_t bodySize = 2;
+                const char* body = "ok";
+
+                if (path.compare(0, 7, "/bytes/") == 0)
+                {
+                    bodySize = std::min<size_t>(std::stoul(path.substr(7)), payload().size());
+                    body = payload().data();
+                }
+
+                const auto responseHead = "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: " + std::to_string(bodySize) + "\r\n\r\n";
+
+                if (!sendAll(clientSocket, responseHead.data(), responseHead.size()) || !sendAll(clientSocket, body, bodySize))
+                {
+                    return;
+                }
+            }
+        }
+    };
+}
+
+#endif //LIBCPP_HTTP_CLIENT_LOOPBACK_SERVER_HPP
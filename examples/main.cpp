@@ -232,6 +232,121 @@ void setTimeout()
     std::cout << "Error Message: " << response.errorMessage << std::endl;
 }
 
+void setDeadlineAndCancel()
+{
+    CancellationToken token;
+
+    HttpRequest httpRequest("https://httpbun.com/delay/5");
+
+    // Connection must be established in 500ms and the whole request must complete in 2 seconds
+    auto future = httpRequest
+                  .setConnectTimeout(std::chrono::milliseconds(500))
+                  .setDeadline(std::chrono::steady_clock::now() + std::chrono::seconds(2))
+                  .setCancellationToken(token)
+                  .send();
+
+    // Give up before the deadline
+    token.cancel();
+
+    auto response = future.get();
+
+    std::cout << "Error Message: " << response.errorMessage << std::endl;
+}
+
+void hedgeSlowRequest()
+{
+    HttpClient client;
+
+    // If the first replica doesn't answer in 100ms, the same request is also sent to the second one
+    auto policy = HedgingPolicy()
+                  .setDelay(std::chrono::milliseconds(100))
+                  .addAlternateUrl("https://httpbun.com/get");
+
+    auto response = client.send(HttpRequest("https://httpbun.com/delay/1").setHedging(policy)).get();
+
+    std::cout << "Succeed: " << response.succeed << std::endl;
+    std::cout << "Winning attempt: " << response.attempt << std::endl;
+}
+
+void retryFailedRequest()
+{
+    HttpRequest httpRequest("https://httpbun.com/status/503");
+
+    // Up to 2 retries, waiting a random time up to 100ms, 200ms... (or as long as the Retry-After header says)
+    auto response = httpRequest
+                    .setRetryPolicy(RetryPolicy()
+                                    .setMaxAttempts(3)
+                                    .setBackoff(std::chrono::milliseconds(100), std::chrono::seconds(2)))
+                    .send()
+                    .get();
+
+    std::cout << "Succeed: " << response.succeed << std::endl;
+    std::cout << "Http Status Code: " << response.statusCode << std::endl;
+    std::cout << "Last attempt: " << response.attempt << std::endl;
+}
+
+void cacheResponses()
+{
+    auto cache = std::make_shared<HttpCache>();
+
+    for (int i = 0; i < 2; i++)
+    {
+        HttpRequest httpRequest("https://httpbun.com/cache/60");
+
+        // The second request is served from the cache without contacting the server
+        auto response = httpRequest
+                        .setCache(cache)
+                        .send()
+                        .get();
+
+        std::cout << "Succeed: " << response.succeed << std::endl;
+        std::cout << "Served from cache: " << (response.cacheStatus == CacheStatus::HIT) << std::endl;
+    }
+}
+
+void coalesceRequests()
+{
+    auto coalescer = std::make_shared<RequestCoalescer>();
+
+    std::vector<HttpRequest> requests(3, HttpRequest("https://httpbun.com/delay/1"));
+
+    std::vector<std::future<HttpResult>> futures;
+
+    // Only one of the identical requests is sent, the others receive its result
+    for (auto& request : requests)
+    {
+        futures.push_back(request.setCoalescer(coalescer).send());
+    }
+
+    for (auto& future : futures)
+    {
+        auto response = future.get();
+
+        std::cout << "Succeed: " << response.succeed << std::endl;
+        std::cout << "Coalesced: " << response.coalesced << std::endl;
+        std::cout << "Data: " << response.sharedData.view() << std::endl;
+    }
+}
+
+void returnAsShared()
+{
+    HttpRequest httpRequest("https://httpbun.com/bytes/100000");
+
+    // The body is received into a reference-counted buffer that can be shared without copying it
+    auto response = httpRequest
+                    .returnAsShared()
+                    .send()
+                    .get();
+
+    auto forLogger = response.sharedData;
+    auto forParser = response.sharedData;
+
+    std::cout << "Succeed: " << response.succeed << std::endl;
+    std::cout << "Data Size: " << forParser.size() << std::endl;
+    std::cout << "Chunks: " << forLogger.chunks().size() << std::endl;
+    std::cout << "Shared by: " << response.sharedData.useCount() << std::endl;
+}
+
 void setDownloadAndUploadBandwidthLimit()
 {
     HttpRequest httpRequest("https://httpbun.com/get");
@@ -265,6 +380,40 @@ void getCurlCommand()
     std::cout << "Curl Command: " << response.toCurlCommand() << std::endl;
 }
 
+void receiveCompressed()
+{
+    HttpRequest httpRequest("https://httpbun.com/get");
+
+    // The response is decompressed while it is being received
+    auto response = httpRequest
+                    .acceptCompression()
+                    .send()
+                    .get();
+
+    std::cout << "Succeed: " << response.succeed << std::endl;
+    std::cout << "Received bytes: " << response.wireBytes << std::endl;
+    std::cout << "Decoded bytes: " << response.decodedBytes << std::endl;
+}
+
+void compressPayload()
+{
+#ifdef LIBCPP_HTTP_CLIENT_WITH_ZLIB
+    HttpRequest httpRequest("https://httpbun.com/post");
+
+    // The payload is compressed with gzip and sent with the "Content-Encoding: gzip" header
+    auto response = httpRequest
+                    .setMethod(HttpMethod::POST)
+                    .setPayload(R"({"param1": 7, "param2": "test"})")
+                    .addHeader("Content-Type", "application/json")
+                    .compressPayload(CompressionCodec::GZIP)
+                    .send()
+                    .get();
+
+    std::cout << "Succeed: " << response.succeed << std::endl;
+    std::cout << "Data: " << response.textData << std::endl;
+#endif
+}
+
 void streamData()
 {
     HttpRequest httpRequest("https://httpbun.com/bytes/5000");
@@ -284,6 +433,279 @@ void streamData()
     std::cout << "Http Status Code: " << response.statusCode << std::endl;
 }
 
+void reuseConnections()
+{
+    // All requests share a process-wide connection pool by default, you can also create your own pool
+    auto pool = std::make_shared<ConnectionPool>();
+
+    pool->setMaxIdleConnectionsPerHost(4).setIdleTimeout(30);
+
+    HttpRequest httpRequest1("https://httpbun.com/get");
+    HttpRequest httpRequest2("https://httpbun.com/get");
+
+    // The second request reuses the TCP/TLS connection opened by the first one
+    auto response1 = httpRequest1.setConnectionPool(pool).send().get();
+    auto response2 = httpRequest2.setConnectionPool(pool).send().get();
+
+    std::cout << "Response1 Succeed: " << response1.succeed << std::endl;
+    std::cout << "Response2 Succeed: " << response2.succeed << std::endl;
+    std::cout << "Idle Connections: " << pool->idleConnectionCount() << std::endl;
+}
+
+void cacheDnsLookups()
+{
+    auto pool = std::make_shared<ConnectionPool>();
+
+    // Resolved addresses are shared by all requests using the pool and kept for 5 minutes
+    pool->setDnsCacheTimeout(300);
+
+    // Resolve the hosts at startup, so that the first requests don't wait for name resolution
+    pool->prefetchHosts({"https://httpbun.com"});
+
+    // Requests to api.myproject.com:443 go to the given address without resolving it
+    pool->addResolveOverride("api.myproject.com", 443, "127.0.0.1");
+
+    auto response = HttpRequest("https://httpbun.com/get").setConnectionPool(pool).send().get();
+
+    std::cout << "Succeed: " << response.succeed << std::endl;
+}
+
+void resumeTlsSessions()
+{
+    auto pool = std::make_shared<ConnectionPool>();
+
+    // New connections to the same host resume the TLS session of the previous ones instead of a full handshake
+    auto response = HttpRequest("https://httpbun.com/get").setConnectionPool(pool).send().get();
+
+    // Sessions can be saved before exit and imported after a restart
+    const auto sessions = pool->exportTlsSessions();
+
+    auto restartedPool = std::make_shared<ConnectionPool>();
+
+    std::cout << "Exported Sessions: " << sessions.size() << std::endl;
+    std::cout << "Imported Sessions: " << restartedPool->importTlsSessions(sessions) << std::endl;
+}
+
+void sendWithHttpClient()
+{
+    // HttpClient runs all requests on its own event loop thread instead of a new thread per request
+    HttpClient client;
+
+    std::vector<std::future<HttpResult>> futures;
+
+    for (int i = 0; i < 10; i++)
+    {
+        HttpRequest httpRequest("https://httpbun.com/get");
+
+        futures.push_back(client.send(httpRequest.setQueryString("param1=" + std::to_string(i))));
+    }
+
+    for (auto& future : futures)
+    {
+        auto response = future.get();
+
+        std::cout << "Succeed: " << response.succeed << std::endl;
+    }
+}
+
+void sendWithCallback()
+{
+    std::promise<void> completed;
+
+    // The callback is called on the event loop thread of the process-wide client, no future is created
+    HttpRequest("https://httpbun.com/get").send([&completed](HttpResult&& result)
+    {
+        std::cout << "Succeed: " << result.succeed << std::endl;
+
+        completed.set_value();
+    });
+
+    completed.get_future().wait();
+}
+
+void sendBatch()
+{
+    HttpClient client;
+
+    std::vector<HttpRequest> requests;
+
+    for (int i = 0; i < 10; i++)
+    {
+        requests.emplace_back("https://httpbun.com/get?param1=" + std::to_string(i));
+    }
+
+    // Results are returned as soon as each request completes
+    auto batch = client.sendAll(requests);
+
+    while (auto completed = batch.next())
+    {
+        std::cout << "Request " << completed->index << " Succeed: " << completed->result.succeed << std::endl;
+    }
+
+    // Results of all requests in the order of the requests
+    auto results = client.whenAll(requests).get();
+
+    // The first successful result
+    auto first = client.whenAny(requests).get();
+
+    std::cout << "Results: " << results.size() << ", First: " << first.index << std::endl;
+}
+
+void sendWithThreadPoolExecutor()
+{
+    // 4 worker threads and at most 100 requests waiting in the queue
+    ThreadPoolExecutor executor(4, 100, QueueFullPolicy::BLOCK);
+
+    HttpRequest httpRequest1("https://httpbun.com/get");
+    HttpRequest httpRequest2("https://httpbun.com/get");
+
+    // Requests run on the worker threads of the executor instead of a new thread per request
+    auto future1 = httpRequest1.send(executor);
+    auto future2 = httpRequest2.send(executor);
+
+    std::cout << "Response1 Succeed: " << future1.get().succeed << std::endl;
+    std::cout << "Response2 Succeed: " << future2.get().succeed << std::endl;
+}
+
+void setHttpVersion()
+{
+    HttpClient client;
+
+    // At most 50 requests are multiplexed as streams on a single HTTP/2 connection
+    client.setMaxStreamsPerConnection(50);
+
+    HttpRequest httpRequest("https://httpbun.com/get");
+
+    // You can set the HTTP version to be used for the request with setHttpVersion method
+    auto response = client.send(httpRequest.setHttpVersion(HttpVersion::HTTP_2_TLS)).get();
+
+    std::cout << "Succeed: " << response.succeed << std::endl;
+}
+
+void receiveIntoBuffer()
+{
+    std::vector<unsigned char> buffer(1024 * 1024);
+
+    HttpRequest httpRequest("https://httpbun.com/bytes/100");
+
+    // The response body is written directly into the given buffer without any reallocation
+    auto response = httpRequest
+                    .setResponseBuffer(buffer.data(), buffer.size())
+                    .send()
+                    .get();
+
+    std::cout << "Succeed: " << response.succeed << std::endl;
+    std::cout << "Bytes Written: " << response.bytesWritten << std::endl;
+}
+
+void useResponseBufferPool()
+{
+    auto pool = std::make_shared<ResponseBufferPool>();
+
+    HttpClient client;
+
+    // Response buffers of all requests sent by the client are taken from the pool
+    client.setResponseBufferPool(pool);
+
+    for (int i = 0; i < 10; i++)
+    {
+        // Buffers are returned to the pool when the response is destroyed
+        auto response = client.send(HttpRequest("https://httpbun.com/bytes/5000").returnAsBinary()).get();
+    }
+
+    std::cout << "Hit Rate: " << pool->statistics().hitRate() << std::endl;
+    std::cout << "Bytes Held: " << pool->statistics().bytesHeld << std::endl;
+}
+
+void readResponseHeaders()
+{
+    HttpRequest httpRequest("https://httpbun.com/get");
+
+    auto response = httpRequest.send().get();
+
+    // Header names are case-insensitive
+    std::cout << "Content-Type: " << response.headers.get("content-type") << std::endl;
+
+    for (const auto& header : response.headers.entries())
+    {
+        std::cout << header.first << ": " << header.second << std::endl;
+    }
+}
+
+void streamPayload()
+{
+    std::istringstream payload("param1=7&param2=test");
+
+    HttpRequest httpRequest("https://httpbun.com/post");
+
+    // The payload is read from the stream piece by piece while it is being sent
+    auto response = httpRequest
+                    .setMethod(HttpMethod::POST)
+                    .setPayloadStream(payload, 20)
+                    .send()
+                    .get();
+
+    std::cout << "Succeed: " << response.succeed << std::endl;
+    std::cout << "Data: " << response.textData << std::endl;
+}
+
+void transferFiles()
+{
+    HttpRequest downloadRequest("https://httpbun.com/bytes/5000");
+
+    // The response is written directly into the file instead of memory
+    auto downloadResponse = downloadRequest
+                            .downloadToFile("download.bin", FileSyncPolicy::ON_COMPLETE)
+                            .send()
+                            .get();
+
+    std::cout << "Download Succeed: " << downloadResponse.succeed << std::endl;
+    std::cout << "Bytes Written: " << downloadResponse.bytesWritten << std::endl;
+
+    HttpRequest uploadRequest("https://httpbun.com/put");
+
+    // The file is memory mapped and sent without being copied
+    auto uploadResponse = uploadRequest
+                          .setMethod(HttpMethod::PUT)
+                          .setPayloadFromFile("download.bin")
+                          .send()
+                          .get();
+
+    std::cout << "Upload Succeed: " << uploadResponse.succeed << std::endl;
+}
+
+void collectTimings()
+{
+    HttpRequest httpRequest("https://httpbun.com/get");
+
+    // Timing breakdown is only collected if it is requested
+    auto response = httpRequest.collectTimings().send().get();
+
+    std::cout << "DNS: " << response.timings.nameLookup.count() << "us" << std::endl;
+    std::cout << "Connect: " << response.timings.connect.count() << "us" << std::endl;
+    std::cout << "TLS: " << response.timings.tlsHandshake.count() << "us" << std::endl;
+    std::cout << "TTFB: " << response.timings.startTransfer.count() << "us" << std::endl;
+    std::cout << "Total: " << response.timings.total.count() << "us" << std::endl;
+    std::cout << "Connection Reused: " << response.timings.connectionReused << std::endl;
+}
+
+void collectMetrics()
+{
+    auto metrics = std::make_shared<HttpMetrics>();
+
+    HttpClient client;
+
+    // Counters and latencies of all requests sent by the client are recorded to the registry
+    client.setMetrics(metrics);
+
+    auto response = client.send(HttpRequest("https://httpbun.com/get")).get();
+
+    std::cout << "p99: " << metrics->snapshot().series[0].latency.percentile(0.99).count() << "us" << std::endl;
+
+    // Can be served to Prometheus as is
+    std::cout << metrics->toOpenMetrics() << std::endl;
+}
+
 int main()
 {
     simpleGet();
@@ -314,11 +736,57 @@ int main()
 
     setTimeout();
 
+    setDeadlineAndCancel();
+
+    hedgeSlowRequest();
+
+    retryFailedRequest();
+
+    cacheResponses();
+
+    coalesceRequests();
+
+    returnAsShared();
+
     setDownloadAndUploadBandwidthLimit();
 
     getCurlCommand();
 
     streamData();
 
+    receiveCompressed();
+
+    compressPayload();
+
+    reuseConnections();
+
+    cacheDnsLookups();
+
+    resumeTlsSessions();
+
+    sendWithHttpClient();
+
+    sendWithCallback();
+
+    sendBatch();
+
+    sendWithThreadPoolExecutor();
+
+    setHttpVersion();
+
+    receiveIntoBuffer();
+
+    useResponseBufferPool();
+
+    readResponseHeaders();
+
+    streamPayload();
+
+    transferFiles();
+
+    collectTimings();
+
+    collectMetrics();
+
     return 0;
 }
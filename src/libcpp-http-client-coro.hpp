@@ -0,0 +1,147 @@
+/*
+
+C++20 coroutine support for libcpp-http-client
+version 1.5.0
+https://github.com/leventkaragol/libcpp-http-client
+
+If you encounter any issues, please submit a ticket at https://github.com/leventkaragol/libcpp-http-client/issues
+
+Copyright (c) 2024 Levent KARAGÖL
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#ifndef LIBCPP_HTTP_CLIENT_CORO_HPP
+#define LIBCPP_HTTP_CLIENT_CORO_HPP
+
+#include <coroutine>
+#include "libcpp-http-client.hpp"
+
+namespace lklibs
+{
+    /**
+     * @brief Awaitable that sends a request on an HttpClient and resumes the awaiting coroutine when the request is completed
+     * The coroutine is resumed on the event loop thread of the client, or on the executor if one is given,
+     * so no thread is blocked while the request is in progress. If the request is completed before submit returns
+     * (e.g. a cached result or a stopped client), the coroutine is not suspended and continues on its own thread
+     */
+    class HttpRequestAwaiter
+    {
+    public:
+        /**
+         * @brief Constructor for the HttpRequestAwaiter class
+         *
+         * @param request: Request to be sent
+         * @param client: Client that the request will be sent on
+         * @param executor: Executor that the coroutine will be resumed on (nullptr resumes it on the event loop thread)
+         */
+        HttpRequestAwaiter(HttpRequest request, HttpClient& client, Executor* executor = nullptr) noexcept
+            : request(std::move(request)), client(client), executor(executor)
+        {
+        }
+
+        [[nodiscard]] bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) noexcept
+        {
+            client.submit(std::move(request), [this, handle](HttpResult&& completed)
+            {
+                result = std::move(completed);
+
+                // Completed before await_suspend returned, the coroutine is not suspended so it must not be resumed here
+                if (!settled.exchange(true, std::memory_order_acq_rel))
+                {
+                    return;
+                }
+
+                // If the executor doesn't accept the task, the coroutine is resumed on the event loop thread instead of being lost
+                if (executor && executor->execute([handle]
+                {
+                    handle.resume();
+                }))
+                {
+                    return;
+                }
+
+                handle.resume();
+            });
+
+            // Resuming the coroutine inside submit would nest it in the call stack, it continues when this returns false instead
+            return !settled.exchange(true, std::memory_order_acq_rel);
+        }
+
+        HttpResult await_resume() noexcept
+        {
+            return std::move(result);
+        }
+
+    private:
+        HttpRequest request;
+        HttpClient& client;
+        Executor* executor;
+        HttpResult result;
+        // Set by whichever of await_suspend and the completion callback finishes first
+        std::atomic<bool> settled{false};
+    };
+
+    /**
+     * @brief Send the request on the given client and return an awaitable for its result
+     *
+     * @param client: Client that the request will be sent on
+     * @param request: Request to be sent
+     * @param executor: Executor that the coroutine will be resumed on (nullptr resumes it on the event loop thread)
+     *
+     * @return Awaitable that returns the HttpResult of the request
+     */
+    inline HttpRequestAwaiter sendAsync(HttpClient& client, HttpRequest request, Executor* executor = nullptr) noexcept
+    {
+        return {std::move(request), client, executor};
+    }
+
+    /**
+     * @brief Send the request on the process-wide HttpClient and return an awaitable for its result
+     *
+     * @param request: Request to be sent
+     * @param executor: Executor that the coroutine will be resumed on (nullptr resumes it on the event loop thread)
+     *
+     * @return Awaitable that returns the HttpResult of the request
+     */
+    inline HttpRequestAwaiter sendAsync(HttpRequest request, Executor* executor = nullptr) noexcept
+    {
+        return {std::move(request), *HttpClient::shared(), executor};
+    }
+
+    /**
+     * @brief Makes an HttpRequest co_await-able, the request is sent on the process-wide HttpClient
+     *
+     * @param request: Request to be sent
+     *
+     * @return Awaitable that returns the HttpResult of the request
+     */
+    inline HttpRequestAwaiter operator co_await(const HttpRequest& request) noexcept
+    {
+        return {request, *HttpClient::shared()};
+    }
+}
+
+#endif //LIBCPP_HTTP_CLIENT_CORO_HPP
@@ -33,541 +33,7539 @@ SOFTWARE.
 
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <chrono>
+#include <deque>
 #include <functional>
 #include <future>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <sstream>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <thread>
+#include <condition_variable>
+#include <istream>
+#include <fstream>
+#include <cstdio>
+#include <array>
+#include <cmath>
+#include <shared_mutex>
+#include <tuple>
+#include <ctime>
+#include <optional>
+#include <random>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
+#include <system_error>
+#include <cstdint>
 #include <curl/curl.h>
 
+#ifdef LIBCPP_HTTP_CLIENT_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef LIBCPP_HTTP_CLIENT_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 namespace lklibs
 {
     /**
-     * @brief Contains the result of HTTP requests
+     * @brief HTTP Version options for the request
      */
-    class HttpResult
+    enum class HttpVersion
+    {
+        DEFAULT,
+        HTTP_1_0,
+        HTTP_1_1,
+        HTTP_2, /* HTTP/2 if possible, otherwise HTTP/1.1 */
+        HTTP_2_TLS, /* HTTP/2 for HTTPS only, HTTP/1.1 for plain HTTP */
+        HTTP_2_PRIOR_KNOWLEDGE /* HTTP/2 without upgrade, also for plain HTTP (h2c) */
+    };
+
+    /**
+     * @brief Timing breakdown and transfer details of a request
+     * Times are measured from the start of the request, like the timing variables of the curl command
+     */
+    struct HttpTimings
     {
-    public:
         /**
-         * @brief Information on whether the request was successful or not
+         * @brief Information on whether the timings are collected (see HttpRequest::collectTimings)
          */
-        bool succeed = false;
+        bool collected = false;
 
         /**
-         * @brief HTTP status code resulting from the request
+         * @brief Time until the name resolving is completed
          */
-        int statusCode = 0;
+        std::chrono::microseconds nameLookup{0};
 
         /**
-         * @brief Text data received as a result of the request
+         * @brief Time until the TCP connection to the server is established
          */
-        std::string textData;
+        std::chrono::microseconds connect{0};
 
         /**
-         * @brief Binary data received as a result of the request
+         * @brief Time until the TLS handshake is completed (0 for plain HTTP)
          */
-        std::vector<unsigned char> binaryData;
+        std::chrono::microseconds tlsHandshake{0};
 
         /**
-         * @brief Error message received as a result of the request
+         * @brief Time until the first byte of the response is received (TTFB)
          */
-        std::string errorMessage;
+        std::chrono::microseconds startTransfer{0};
 
-        HttpResult() = default;
+        /**
+         * @brief Total time of the request
+         */
+        std::chrono::microseconds total{0};
 
-        HttpResult(const bool succeed, std::string textData, std::vector<unsigned char> binaryData, const int statusCode, std::string errorMessage)
-            : succeed(succeed), textData(std::move(textData)), binaryData(std::move(binaryData)), statusCode(statusCode), errorMessage(std::move(errorMessage))
-        {
-        }
-    };
+        /**
+         * @brief Number of payload bytes sent
+         */
+        long long uploadedBytes = 0;
 
-    /**
-     * @brief HTTP Method options for the request
-     */
-    enum class HttpMethod
-    {
-        GET,
-        POST,
-        PUT,
-        DELETE_,
-        PATCH
-    };
+        /**
+         * @brief Number of response body bytes received
+         */
+        long long downloadedBytes = 0;
 
-    /**
-     * @brief TLS Version options for the request
-     */
-    enum class TLSVersion
-    {
-        DEFAULT,
-        TLSv1, /* TLS 1.x */
-        SSLv2,
-        SSLv3,
-        TLSv1_0,
-        TLSv1_1,
-        TLSv1_2,
-        TLSv1_3
+        /**
+         * @brief Information on whether an existing connection is reused instead of opening a new one
+         */
+        bool connectionReused = false;
+
+        /**
+         * @brief HTTP version used for the response
+         */
+        HttpVersion httpVersion = HttpVersion::DEFAULT;
     };
 
     /**
-     * @brief Class to initialize and cleanup the curl library
+     * @brief Statistics of a ResponseBufferPool
      */
-    class CurlGlobalInitializer
+    struct ResponseBufferPoolStatistics
     {
-    public:
         /**
-         * @brief Static initialize method that ensures that curl is initialized only once when it is first used in the program
+         * @brief Number of buffers taken from the pool
          */
-        static void initialize()
-        {
-            static bool initialized = false;
-
-            static std::mutex init_mutex;
+        size_t hits = 0;
 
-            std::lock_guard<std::mutex> lock(init_mutex);
+        /**
+         * @brief Number of buffers newly allocated because the pool had no buffer of the required size
+         */
+        size_t misses = 0;
 
-            if (!initialized)
-            {
-                CURLcode result = curl_global_init(CURL_GLOBAL_DEFAULT);
+        /**
+         * @brief Number of buffers returned to the pool
+         */
+        size_t returned = 0;
 
-                if (result == CURLE_OK)
-                {
-                    initialized = true;
+        /**
+         * @brief Number of returned buffers freed because the pool was full
+         */
+        size_t discarded = 0;
 
-                    std::atexit(cleanup);
-                }
-            }
-        }
+        /**
+         * @brief Total capacity of the buffers currently kept in the pool in bytes
+         */
+        size_t bytesHeld = 0;
 
-    private:
-        static void cleanup()
+        /**
+         * @brief Ratio of the buffers taken from the pool to all buffers requested
+         */
+        [[nodiscard]] double hitRate() const noexcept
         {
-            curl_global_cleanup();
+            return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(hits + misses);
         }
     };
 
     /**
-     * @brief HTTP request class that makes asynchronous HTTP calls
+     * @brief Pool of recyclable response buffers grouped by size classes
+     * Buffers taken by an HttpResult are returned to the pool when the result is destroyed or
+     * HttpResult::releaseBuffers() is called, so steady state traffic doesn't allocate new buffers
      */
-    class HttpRequest
+    class ResponseBufferPool
     {
     public:
         /**
-         * @brief Constructor for the HttpRequest class
+         * @brief Constructor for the ResponseBufferPool class
          *
-         * @param url: URL for the request
+         * @param maxBytes: Maximum total capacity of the buffers kept in the pool
+         * @param maxBuffersPerSizeClass: Maximum number of buffers kept for each size class
          */
-        explicit HttpRequest(const std::string& url)
+        explicit ResponseBufferPool(const size_t maxBytes = 64 * 1024 * 1024, const size_t maxBuffersPerSizeClass = 64)
+            : maxBytes(maxBytes), maxBuffersPerSizeClass(maxBuffersPerSizeClass)
         {
-            this->url = url;
-
-            CurlGlobalInitializer::initialize();
         }
 
+        ResponseBufferPool(const ResponseBufferPool&) = delete;
+
+        ResponseBufferPool& operator=(const ResponseBufferPool&) = delete;
+
         /**
-         * @brief Set the HTTP method for the request
+         * @brief Get the statistics of the pool
          *
-         * @param method: HTTP method to be used for the request
+         * @return Counters and the number of bytes held by the pool
          */
-        HttpRequest& setMethod(const HttpMethod& method) noexcept
+        [[nodiscard]] ResponseBufferPoolStatistics statistics() const noexcept
         {
-            this->method = HttpMethodStrings[static_cast<int>(method)];
+            std::lock_guard<std::mutex> lock(mutex);
 
-            return *this;
+            return stats;
         }
 
         /**
-         * @brief Set the query string for the request
-         *
-         * @param queryString: Query string to be sent with the request
+         * @brief Free all buffers kept in the pool
          */
-        HttpRequest& setQueryString(const std::string& queryString) noexcept
+        void clear() noexcept
         {
-            if (this->url.find('?') != std::string::npos)
+            std::lock_guard<std::mutex> lock(mutex);
+
+            for (auto& sizeClass : textBuffers)
             {
-                this->url += "&" + queryString;
+                sizeClass.clear();
             }
-            else
+
+            for (auto& sizeClass : binaryBuffers)
             {
-                this->url += "?" + queryString;
+                sizeClass.clear();
             }
 
-            return *this;
+            stats.bytesHeld = 0;
+        }
+
+    private:
+        friend class HttpRequest;
+        friend class HttpResult;
+
+        static constexpr size_t MinBufferSize = 4 * 1024;
+        static constexpr size_t SizeClassCount = 15; /* 4 KB - 64 MB */
+
+        const size_t maxBytes;
+        const size_t maxBuffersPerSizeClass;
+        mutable std::mutex mutex;
+        std::vector<std::string> textBuffers[SizeClassCount];
+        std::vector<std::vector<unsigned char>> binaryBuffers[SizeClassCount];
+        ResponseBufferPoolStatistics stats;
+
+        static size_t classSize(const size_t sizeClass) noexcept
+        {
+            return MinBufferSize << sizeClass;
         }
 
         /**
-         * @brief Set the payload for the request
-         * You can send form data like param1=7&param2=test or JSON data like {"param1": 7, "param2": "test"}
-         * You need to send the "Content-Type" as "application/json" in the HTTP Header, if you need to send json data in the payload
-         *
-         * @param payload: Payload to be sent with the request
+         * @brief Smallest size class that can hold the given size, SizeClassCount if it is too large
          */
-        HttpRequest& setPayload(const std::string& payload) noexcept
+        static size_t classFor(const size_t size) noexcept
         {
-            this->payload = payload;
+            size_t sizeClass = 0;
 
-            return *this;
+            while (sizeClass < SizeClassCount && classSize(sizeClass) < size)
+            {
+                sizeClass++;
+            }
+
+            return sizeClass;
         }
 
         /**
-         * @brief Set the return format for the request as binary
+         * @brief Largest size class whose size fits into the given capacity, SizeClassCount if it is too small
          */
-        HttpRequest& returnAsBinary() noexcept
+        static size_t classOf(const size_t capacity) noexcept
         {
-            this->returnFormat = ReturnFormat::BINARY;
+            if (capacity < MinBufferSize)
+            {
+                return SizeClassCount;
+            }
 
-            return *this;
+            size_t sizeClass = 0;
+
+            while (sizeClass + 1 < SizeClassCount && classSize(sizeClass + 1) <= capacity)
+            {
+                sizeClass++;
+            }
+
+            return sizeClass;
         }
 
-        /**
-         * @brief Add a HTTP header to the request
-         *
-         * @param key: Header key
-         * @param value: Header value
-         */
-        HttpRequest& addHeader(const std::string& key, const std::string& value) noexcept
+        template <typename Buffer>
+        Buffer acquire(std::vector<Buffer>* buffers, const size_t size) noexcept
         {
-            this->headers[key] = value;
+            const auto sizeClass = classFor(size);
 
-            return *this;
+            Buffer buffer;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                if (sizeClass < SizeClassCount && !buffers[sizeClass].empty())
+                {
+                    buffer = std::move(buffers[sizeClass].back());
+
+                    buffers[sizeClass].pop_back();
+
+                    stats.hits++;
+                    stats.bytesHeld -= std::min(stats.bytesHeld, buffer.capacity());
+
+                    return buffer;
+                }
+
+                stats.misses++;
+            }
+
+            // Larger sizes than the largest size class are not reserved at once, the buffer grows as the data is received
+            buffer.reserve(classSize(std::min(sizeClass, SizeClassCount - 1)));
+
+            return buffer;
         }
 
-        /**
-         * @brief Set the timeout for the request
-         *
-         * @param timeout: Timeout in seconds (0 for no timeout)
-         */
-        HttpRequest& setTimeout(const int timeout) noexcept
+        template <typename Buffer>
+        void release(std::vector<Buffer>* buffers, Buffer& buffer) noexcept
         {
-            this->timeout = timeout;
+            const auto sizeClass = classOf(buffer.capacity());
 
-            return *this;
+            if (sizeClass == SizeClassCount)
+            {
+                return;
+            }
+
+            buffer.clear();
+
+            std::lock_guard<std::mutex> lock(mutex);
+
+            stats.returned++;
+
+            if (buffers[sizeClass].size() >= maxBuffersPerSizeClass || stats.bytesHeld + buffer.capacity() > maxBytes)
+            {
+                stats.discarded++;
+
+                Buffer().swap(buffer);
+
+                return;
+            }
+
+            stats.bytesHeld += buffer.capacity();
+
+            buffers[sizeClass].push_back(std::move(buffer));
+
+            buffer = Buffer();
         }
 
-        /**
-         * @brief Ignore SSL errors when making HTTP requests
-         */
-        HttpRequest& ignoreSslErrors() noexcept
+        std::string acquireText(const size_t size) noexcept
         {
-            this->sslErrorsWillBeIgnored = true;
+            return acquire(textBuffers, size);
+        }
 
-            return *this;
+        std::vector<unsigned char> acquireBinary(const size_t size) noexcept
+        {
+            return acquire(binaryBuffers, size);
         }
 
-        /**
-         * @brief Set the TLS version for the request
-         *
-         * @param version: TLS version to be used for the request
-         */
-        HttpRequest& setTLSVersion(const TLSVersion version) noexcept
+        void releaseText(std::string& buffer) noexcept
         {
-            this->tlsVersion = version;
+            release(textBuffers, buffer);
+        }
 
-            return *this;
+        void releaseBinary(std::vector<unsigned char>& buffer) noexcept
+        {
+            release(binaryBuffers, buffer);
         }
+    };
 
-        /**
-         * @brief Set the user agent for the request
-         *
-         * @param userAgent: User agent to be used for the request
-         */
-        HttpRequest& setUserAgent(const std::string& userAgent) noexcept
+    /**
+     * @brief Response headers of an HTTP request
+     * Headers are kept as a single raw block and parsed on the first lookup, so responses whose
+     * headers are never read don't pay for parsing them. Names are compared case-insensitively.
+     * Lookups on the same object must not be made from different threads at the same time
+     */
+    class HttpHeaders
+    {
+    public:
+        HttpHeaders() = default;
+
+        explicit HttpHeaders(std::string rawHeaders) noexcept : rawHeaders(std::move(rawHeaders))
         {
-            this->userAgent = userAgent;
+        }
+
+        HttpHeaders(const HttpHeaders& other) : rawHeaders(other.rawHeaders)
+        {
+        }
+
+        HttpHeaders(HttpHeaders&& other) noexcept : rawHeaders(std::move(other.rawHeaders))
+        {
+            other.reset();
+        }
+
+        HttpHeaders& operator=(const HttpHeaders& other)
+        {
+            if (this != &other)
+            {
+                rawHeaders = other.rawHeaders;
+
+                reset();
+            }
 
             return *this;
         }
 
-        /**
-         * @brief Set the download bandwidth limit for the request
-         *
-         * @param limit: Download bandwidth limit in bytes per second (0 for no limit)
-         */
-        HttpRequest& setDownloadBandwidthLimit(const int limit) noexcept
+        HttpHeaders& operator=(HttpHeaders&& other) noexcept
         {
-            this->downloadBandwidthLimit = limit;
+            if (this != &other)
+            {
+                rawHeaders = std::move(other.rawHeaders);
+
+                reset();
+                other.reset();
+            }
 
             return *this;
         }
 
         /**
-         * @brief Set the upload bandwidth limit for the request
+         * @brief Get the value of a header
          *
-         * @param limit: Upload bandwidth limit in bytes per second (0 for no limit)
+         * @param name: Header name (case-insensitive)
+         *
+         * @return Value of the first header with the given name, empty if there is no such header
          */
-        HttpRequest& setUploadBandwidthLimit(const int limit) noexcept
+        [[nodiscard]] std::string_view get(const std::string_view name) const noexcept
         {
-            this->uploadBandwidthLimit = limit;
+            for (const auto& entry : entries())
+            {
+                if (equalsIgnoreCase(entry.first, name))
+                {
+                    return entry.second;
+                }
+            }
 
-            return *this;
+            return {};
         }
 
         /**
-         * @brief The callback that will be triggered when each piece (chunk) of incoming data is processed
+         * @brief Get the values of all headers with the same name (e.g. Set-Cookie)
+         *
+         * @param name: Header name (case-insensitive)
+         *
+         * @return Values in the order they are received
+         */
+        [[nodiscard]] std::vector<std::string_view> getAll(const std::string_view name) const
+        {
+            std::vector<std::string_view> values;
+
+            for (const auto& entry : entries())
+            {
+                if (equalsIgnoreCase(entry.first, name))
+                {
+                    values.push_back(entry.second);
+                }
+            }
+
+            return values;
+        }
+
+        /**
+         * @brief Check whether a header is received
+         *
+         * @param name: Header name (case-insensitive)
+         */
+        [[nodiscard]] bool contains(const std::string_view name) const noexcept
+        {
+            for (const auto& entry : entries())
+            {
+                if (equalsIgnoreCase(entry.first, name))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        /**
+         * @brief Get all headers as name-value pairs in the order they are received
+         * The views point into this object and remain valid as long as it is not modified or destroyed
+         */
+        [[nodiscard]] const std::vector<std::pair<std::string_view, std::string_view>>& entries() const
+        {
+            if (!parsed)
+            {
+                parse();
+            }
+
+            return parsedEntries;
+        }
+
+        /**
+         * @brief Get the number of headers
+         */
+        [[nodiscard]] size_t size() const
+        {
+            return entries().size();
+        }
+
+        /**
+         * @brief Check whether there is no header
+         */
+        [[nodiscard]] bool empty() const
+        {
+            return entries().empty();
+        }
+
+        /**
+         * @brief Get the header block as it is received, including the status line
+         */
+        [[nodiscard]] const std::string& raw() const noexcept
+        {
+            return rawHeaders;
+        }
+
+        static bool equalsIgnoreCase(const std::string_view left, const std::string_view right) noexcept
+        {
+            if (left.size() != right.size())
+            {
+                return false;
+            }
+
+            for (size_t i = 0; i < left.size(); i++)
+            {
+                if (std::tolower(static_cast<unsigned char>(left[i])) != std::tolower(static_cast<unsigned char>(right[i])))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+    private:
+        std::string rawHeaders;
+        mutable std::vector<std::pair<std::string_view, std::string_view>> parsedEntries;
+        mutable bool parsed = false;
+
+        void reset() noexcept
+        {
+            parsedEntries.clear();
+            parsed = false;
+        }
+
+        static std::string_view trim(std::string_view value) noexcept
+        {
+            while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+            {
+                value.remove_prefix(1);
+            }
+
+            while (!value.empty() && (value.back() == ' ' || value.back() == '\t' || value.back() == '\r'))
+            {
+                value.remove_suffix(1);
+            }
+
+            return value;
+        }
+
+        void parse() const
+        {
+            parsed = true;
+
+            const std::string_view block(rawHeaders);
+
+            size_t lineStart = 0;
+
+            while (lineStart < block.size())
+            {
+                auto lineEnd = block.find('\n', lineStart);
+
+                if (lineEnd == std::string_view::npos)
+                {
+                    lineEnd = block.size();
+                }
+
+                const auto line = block.substr(lineStart, lineEnd - lineStart);
+
+                lineStart = lineEnd + 1;
+
+                // Status line, empty line at the end of the block and obsolete line folding are skipped
+                if (line.empty() || line.front() == ' ' || line.front() == '\t' || line.compare(0, 5, "HTTP/") == 0)
+                {
+                    continue;
+                }
+
+                const auto colon = line.find(':');
+
+                if (colon == std::string_view::npos)
+                {
+                    continue;
+                }
+
+                parsedEntries.emplace_back(trim(line.substr(0, colon)), trim(line.substr(colon + 1)));
+            }
+        }
+    };
+
+    /**
+     * @brief How the result of a request is related to the HttpCache set for it
+     */
+    enum class CacheStatus
+    {
+        NONE, /* The request doesn't use a cache or can't be cached */
+        MISS, /* No usable response is stored, the response is received from the server */
+        HIT, /* Fresh stored response, the server is not contacted */
+        STALE, /* Stale stored response, returned while it is revalidated in the background */
+        REVALIDATED /* Stored response, confirmed by the server with "304 Not Modified" */
+    };
+
+    /**
+     * @brief Immutable, reference-counted response body that several results can share without copying it
+     * The body may be kept as a rope of the chunks it is received in, so a large body is never moved to a
+     * bigger buffer while it is being received. Copies of the buffer only copy the reference, so it can be
+     * passed to any number of consumers and threads
+     */
+    class SharedBuffer
+    {
+    public:
+        SharedBuffer() = default;
+
+        explicit SharedBuffer(std::string data)
+        {
+            if (!data.empty())
+            {
+                std::vector<std::string> chunks;
+
+                chunks.push_back(std::move(data));
+
+                storage = std::make_shared<const Storage>(std::move(chunks));
+            }
+        }
+
+        explicit SharedBuffer(std::vector<std::string> chunks)
+        {
+            chunks.erase(std::remove_if(chunks.begin(), chunks.end(), [](const std::string& chunk)
+            {
+                return chunk.empty();
+            }), chunks.end());
+
+            if (!chunks.empty())
+            {
+                storage = std::make_shared<const Storage>(std::move(chunks));
+            }
+        }
+
+        /**
+         * @brief Get the body as a single contiguous view, valid as long as any copy of the buffer exists
+         * If the body is kept in more than one chunk, the chunks are joined into one block on the first call
+         * and the same block is returned afterwards. Use chunks() to read the body without joining it
+         */
+        [[nodiscard]] std::string_view view() const
+        {
+            if (!storage)
+            {
+                return {};
+            }
+
+            if (storage->chunks.size() == 1)
+            {
+                return storage->chunks.front();
+            }
+
+            std::call_once(storage->joinOnce, [this]
+            {
+                storage->joined.reserve(storage->size);
+
+                for (const auto& chunk : storage->chunks)
+                {
+                    storage->joined.append(chunk);
+                }
+            });
+
+            return storage->joined;
+        }
+
+        /**
+         * @brief Get the pieces the body is kept in, in order, without copying or joining them
+         */
+        [[nodiscard]] std::vector<std::string_view> chunks() const
+        {
+            std::vector<std::string_view> views;
+
+            if (storage)
+            {
+                views.assign(storage->chunks.begin(), storage->chunks.end());
+            }
+
+            return views;
+        }
+
+        /**
+         * @brief Get a pointer to the contiguous body, see view()
+         */
+        [[nodiscard]] const char* data() const
+        {
+            return storage ? view().data() : nullptr;
+        }
+
+        /**
+         * @brief Get the body as bytes, see view()
+         */
+        [[nodiscard]] const unsigned char* bytes() const
+        {
+            return reinterpret_cast<const unsigned char*>(data());
+        }
+
+        [[nodiscard]] size_t size() const noexcept
+        {
+            return storage ? storage->size : 0;
+        }
+
+        [[nodiscard]] bool empty() const noexcept
+        {
+            return size() == 0;
+        }
+
+        /**
+         * @brief Get the number of buffers and results that share the body
+         */
+        [[nodiscard]] long useCount() const noexcept
+        {
+            return storage.use_count();
+        }
+
+        /**
+         * @brief Copy the body into a new string
+         */
+        [[nodiscard]] std::string toString() const
+        {
+            std::string copy;
+
+            copy.reserve(size());
+
+            for (const auto chunk : chunks())
+            {
+                copy.append(chunk);
+            }
+
+            return copy;
+        }
+
+        /**
+         * @brief Copy the body into a new byte vector
+         */
+        [[nodiscard]] std::vector<unsigned char> toBinary() const
+        {
+            std::vector<unsigned char> copy;
+
+            copy.reserve(size());
+
+            for (const auto chunk : chunks())
+            {
+                copy.insert(copy.end(), chunk.begin(), chunk.end());
+            }
+
+            return copy;
+        }
+
+    private:
+        struct Storage
+        {
+            explicit Storage(std::vector<std::string> chunks) : chunks(std::move(chunks))
+            {
+                for (const auto& chunk : this->chunks)
+                {
+                    size += chunk.size();
+                }
+            }
+
+            const std::vector<std::string> chunks;
+            size_t size = 0;
+            mutable std::once_flag joinOnce;
+            mutable std::string joined;
+        };
+
+        std::shared_ptr<const Storage> storage;
+    };
+
+    /**
+     * @brief Contains the result of HTTP requests
+     */
+    class HttpResult
+    {
+    public:
+        /**
+         * @brief Information on whether the request was successful or not
+         */
+        bool succeed = false;
+
+        /**
+         * @brief HTTP status code resulting from the request
+         */
+        int statusCode = 0;
+
+        /**
+         * @brief Text data received as a result of the request
+         */
+        std::string textData;
+
+        /**
+         * @brief Binary data received as a result of the request
+         */
+        std::vector<unsigned char> binaryData;
+
+        /**
+         * @brief Error message received as a result of the request
+         */
+        std::string errorMessage;
+
+        /**
+         * @brief Number of bytes written into the buffer set by setResponseBuffer or the file set by downloadToFile
+         */
+        size_t bytesWritten = 0;
+
+        /**
+         * @brief Size of the response body as it is received over the network, compressed if the server compressed it
+         */
+        long long wireBytes = 0;
+
+        /**
+         * @brief Size of the response body after it is decompressed (the same as wireBytes if it is not compressed)
+         */
+        long long decodedBytes = 0;
+
+        /**
+         * @brief Headers of the final response (headers of redirects and interim responses are not included)
+         */
+        HttpHeaders headers;
+
+        /**
+         * @brief Timing breakdown of the request, only filled if HttpRequest::collectTimings is called
+         */
+        HttpTimings timings;
+
+        /**
+         * @brief Index of the attempt that produced the result, 0 for the original request and 1 or more for retried or hedged attempts
+         */
+        int attempt = 0;
+
+        /**
+         * @brief Whether the result is served from the cache set by HttpRequest::setCache
+         */
+        CacheStatus cacheStatus = CacheStatus::NONE;
+
+        /**
+         * @brief Body as an immutable buffer that can be shared without copying it, filled if HttpRequest::returnAsShared
+         * is called and for coalesced requests (see RequestCoalescer). textData and binaryData are empty when it is filled
+         */
+        SharedBuffer sharedData;
+
+        /**
+         * @brief Whether the result is received by another identical request that was already in progress
+         */
+        bool coalesced = false;
+
+        HttpResult() = default;
+
+        HttpResult(const bool succeed, std::string textData, std::vector<unsigned char> binaryData, const int statusCode, std::string errorMessage)
+            : succeed(succeed), textData(std::move(textData)), binaryData(std::move(binaryData)), statusCode(statusCode), errorMessage(std::move(errorMessage))
+        {
+        }
+
+        HttpResult(const HttpResult&) = default;
+
+        HttpResult(HttpResult&&) noexcept = default;
+
+        HttpResult& operator=(const HttpResult&) = default;
+
+        HttpResult& operator=(HttpResult&&) noexcept = default;
+
+        ~HttpResult()
+        {
+            releaseBuffers();
+        }
+
+        /**
+         * @brief Return textData and binaryData to the ResponseBufferPool they were taken from
+         * Both are empty after this call. Does nothing if the request had no buffer pool
+         */
+        void releaseBuffers() noexcept
+        {
+            if (!bufferPool)
+            {
+                return;
+            }
+
+            bufferPool->releaseText(textData);
+            bufferPool->releaseBinary(binaryData);
+
+            textData.clear();
+            binaryData.clear();
+        }
+
+    private:
+        friend class HttpRequest;
+        friend class RetryPolicy;
+        friend class RequestCoalescer;
+
+        std::shared_ptr<ResponseBufferPool> bufferPool;
+        CURLcode curlCode = CURLE_OK;
+    };
+
+    /**
+     * @brief HTTP Method options for the request
+     */
+    enum class HttpMethod
+    {
+        GET,
+        POST,
+        PUT,
+        DELETE_,
+        PATCH
+    };
+
+    /**
+     * @brief TLS Version options for the request
+     */
+    enum class TLSVersion
+    {
+        DEFAULT,
+        TLSv1, /* TLS 1.x */
+        SSLv2,
+        SSLv3,
+        TLSv1_0,
+        TLSv1_1,
+        TLSv1_2,
+        TLSv1_3
+    };
+
+    /**
+     * @brief Options for flushing a downloaded file to the disk
+     */
+    enum class FileSyncPolicy
+    {
+        NONE, /* Leave flushing to the operating system */
+        ON_COMPLETE /* Flush the file to the disk (fsync) before the result is returned */
+    };
+
+    /**
+     * @brief Codecs that the payload of the request can be compressed with (see HttpRequest::compressPayload)
+     */
+    enum class CompressionCodec
+    {
+        GZIP, /* Requires LIBCPP_HTTP_CLIENT_WITH_ZLIB to be defined and zlib to be linked */
+        ZSTD /* Requires LIBCPP_HTTP_CLIENT_WITH_ZSTD to be defined and zstd to be linked */
+    };
+
+#ifdef LIBCPP_HTTP_CLIENT_WITH_ZSTD
+    /**
+     * @brief Pre-trained zstd dictionary that makes small and similar payloads compress much better
+     * The dictionary is digested once when it is created, so the same object should be shared by the requests.
+     * The server must decompress the payloads with the same dictionary
+     */
+    class ZstdDictionary
+    {
+    public:
+        /**
+         * @brief Constructor for the ZstdDictionary class
+         *
+         * @param dictionary: Dictionary content, as it is created by "zstd --train"
+         * @param level: Compression level of the payloads compressed with the dictionary (1 - 22)
+         */
+        explicit ZstdDictionary(const std::string& dictionary, const int level = 3)
+            : dictionary(ZSTD_createCDict(dictionary.data(), dictionary.size(), level))
+        {
+        }
+
+        ~ZstdDictionary()
+        {
+            ZSTD_freeCDict(dictionary);
+        }
+
+        ZstdDictionary(const ZstdDictionary&) = delete;
+
+        ZstdDictionary& operator=(const ZstdDictionary&) = delete;
+
+        /**
+         * @brief Returns whether the dictionary could be loaded
+         */
+        [[nodiscard]] bool isValid() const noexcept
+        {
+            return dictionary != nullptr;
+        }
+
+    private:
+        friend class HttpRequest;
+
+        ZSTD_CDict* dictionary = nullptr;
+    };
+#endif
+
+    /**
+     * @brief Class to initialize and cleanup the curl library
+     */
+    class CurlGlobalInitializer
+    {
+    public:
+        /**
+         * @brief Static initialize method that ensures that curl is initialized only once when it is first used in the program
+         */
+        static void initialize()
+        {
+            static bool initialized = false;
+
+            static std::mutex init_mutex;
+
+            std::lock_guard<std::mutex> lock(init_mutex);
+
+            if (!initialized)
+            {
+                CURLcode result = curl_global_init(CURL_GLOBAL_DEFAULT);
+
+                if (result == CURLE_OK)
+                {
+                    initialized = true;
+
+                    std::atexit(cleanup);
+                }
+            }
+        }
+
+    private:
+        static void cleanup()
+        {
+            curl_global_cleanup();
+        }
+    };
+
+    /**
+     * @brief TLS session exported from a ConnectionPool to resume it after a restart
+     */
+    struct TlsSession
+    {
+        /**
+         * @brief Key of the peer that the session belongs to (may be empty if the peer is identified by the hmac only)
+         */
+        std::string key;
+
+        /**
+         * @brief Salted hash of the peer key
+         */
+        std::vector<unsigned char> hmac;
+
+        /**
+         * @brief Serialized session data (secret)
+         */
+        std::vector<unsigned char> data;
+
+        /**
+         * @brief The session can't be resumed after this time
+         */
+        std::chrono::system_clock::time_point validUntil;
+    };
+
+    /**
+     * @brief Pool of reusable cURL handles, kept per host, so that the TCP/TLS connections
+     * they hold can be reused by the following requests to the same host
+     */
+    class ConnectionPool
+    {
+    public:
+        /**
+         * @brief Constructor for the ConnectionPool class
+         *
+         * @param maxIdleConnectionsPerHost: Maximum number of idle connections kept for each host
+         * @param idleTimeout: Idle connections older than this value (in seconds) are closed
+         */
+        explicit ConnectionPool(const int maxIdleConnectionsPerHost = 8, const int idleTimeout = 60)
+            : maxIdleConnectionsPerHost(maxIdleConnectionsPerHost), idleTimeout(idleTimeout)
+        {
+            CurlGlobalInitializer::initialize();
+
+            // Resolved addresses and TLS sessions are shared by all requests using the pool, so a host is resolved once
+            // until the cache entry expires and new connections to a host resume the TLS session instead of a full handshake
+            share = curl_share_init();
+
+            if (share)
+            {
+                curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lockShare);
+                curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlockShare);
+                curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+                curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+                curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+            }
+        }
+
+        ~ConnectionPool()
+        {
+            clear();
+
+            if (share)
+            {
+                curl_share_cleanup(share);
+            }
+        }
+
+        ConnectionPool(const ConnectionPool&) = delete;
+
+        ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+        /**
+         * @brief Process-wide connection pool used by all requests unless another pool is set
+         *
+         * @return Shared connection pool instance
+         */
+        static std::shared_ptr<ConnectionPool> shared()
+        {
+            static auto instance = std::make_shared<ConnectionPool>();
+
+            return instance;
+        }
+
+        /**
+         * @brief Set the maximum number of idle connections kept for each host
+         *
+         * @param maxIdleConnections: Maximum number of idle connections (0 disables pooling)
+         */
+        ConnectionPool& setMaxIdleConnectionsPerHost(const int maxIdleConnections) noexcept
+        {
+            this->maxIdleConnectionsPerHost = maxIdleConnections;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the idle timeout of the pooled connections
+         *
+         * @param timeout: Idle timeout in seconds
+         */
+        ConnectionPool& setIdleTimeout(const int timeout) noexcept
+        {
+            this->idleTimeout = timeout;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set how long the resolved addresses are kept in the DNS cache of the pool
+         *
+         * @param timeout: Timeout in seconds (0 disables caching, -1 keeps the addresses forever)
+         */
+        ConnectionPool& setDnsCacheTimeout(const int timeout) noexcept
+        {
+            this->dnsCacheTimeout = timeout;
+
+            return *this;
+        }
+
+        /**
+         * @brief Use the given address for the host and port instead of resolving it, like the --resolve option of curl
+         *
+         * @param host: Host name in the URL
+         * @param port: Port number (443 for HTTPS and 80 for HTTP unless set in the URL)
+         * @param address: IP address to be used, or comma separated addresses to be tried in order
+         */
+        ConnectionPool& addResolveOverride(const std::string& host, const int port, const std::string& address) noexcept
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            const auto hostAndPort = host + ":" + std::to_string(port);
+
+            resolveOverrides[hostAndPort] = address;
+
+            return *this;
+        }
+
+        /**
+         * @brief Remove the address override of the host and port, so that it is resolved again by the next request
+         *
+         * @param host: Host name in the URL
+         * @param port: Port number
+         */
+        ConnectionPool& removeResolveOverride(const std::string& host, const int port) noexcept
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            const auto hostAndPort = host + ":" + std::to_string(port);
+
+            if (resolveOverrides.erase(hostAndPort) > 0)
+            {
+                // Overridden addresses never expire, so the next request removes it from the cache
+                pendingResolveRemovals.push_back("-" + hostAndPort);
+            }
+
+            return *this;
+        }
+
+        /**
+         * @brief Resolve the hosts of the given URLs in parallel and keep the addresses in the DNS cache of the pool
+         * This is meant to be called at startup, so that the first requests don't wait for name resolution.
+         * A TCP connection is opened and closed to each host, since curl has no resolve only operation
+         *
+         * @param urls: URLs of the hosts to be resolved
+         * @param timeout: Maximum time in seconds to wait for all hosts
+         * @return Number of hosts that are resolved
+         */
+        size_t prefetchHosts(const std::vector<std::string>& urls, const int timeout = 10) noexcept
+        {
+            CURLM* multi = curl_multi_init();
+
+            if (!multi)
+            {
+                return 0;
+            }
+
+            std::vector<CURL*> handles;
+            std::vector<std::string> targets;
+
+            targets.reserve(urls.size());
+
+            for (const auto& url : urls)
+            {
+                targets.push_back(getConnectTarget(url));
+
+                CURL* handle = targets.back().empty() ? nullptr : curl_easy_init();
+
+                if (!handle)
+                {
+                    continue;
+                }
+
+                curl_easy_setopt(handle, CURLOPT_URL, targets.back().c_str());
+                curl_easy_setopt(handle, CURLOPT_CONNECT_ONLY, 1L);
+                curl_easy_setopt(handle, CURLOPT_SHARE, share);
+                curl_easy_setopt(handle, CURLOPT_DNS_CACHE_TIMEOUT, static_cast<long>(dnsCacheTimeout.load()));
+                curl_easy_setopt(handle, CURLOPT_TIMEOUT, static_cast<long>(timeout));
+                curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+
+                if (curl_multi_add_handle(multi, handle) != CURLM_OK)
+                {
+                    curl_easy_cleanup(handle);
+
+                    continue;
+                }
+
+                handles.push_back(handle);
+            }
+
+            int running = static_cast<int>(handles.size());
+
+            while (running > 0)
+            {
+                if (curl_multi_perform(multi, &running) != CURLM_OK)
+                {
+                    break;
+                }
+
+                if (running > 0)
+                {
+                    curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+                }
+            }
+
+            size_t resolved = 0;
+
+            for (auto* handle : handles)
+            {
+                char* address = nullptr;
+
+                curl_easy_getinfo(handle, CURLINFO_PRIMARY_IP, &address);
+
+                if (address && *address)
+                {
+                    resolved++;
+                }
+
+                curl_multi_remove_handle(multi, handle);
+                curl_easy_cleanup(handle);
+            }
+
+            curl_multi_cleanup(multi);
+
+            return resolved;
+        }
+
+        /**
+         * @brief Check whether the libcurl in use can export and import TLS sessions
+         * Requires libcurl 8.12.0 or later that is built with the ssls-export feature
+         */
+        static bool supportsTlsSessionExport() noexcept
+        {
+#if LIBCURL_VERSION_NUM >= 0x080c00
+            CurlGlobalInitializer::initialize();
+
+            CURL* handle = curl_easy_init();
+
+            if (!handle)
+            {
+                return false;
+            }
+
+            const auto res = curl_easy_ssls_export(handle, exportTlsSession, nullptr);
+
+            curl_easy_cleanup(handle);
+
+            return res != CURLE_NOT_BUILT_IN;
+#else
+            return false;
+#endif
+        }
+
+        /**
+         * @brief Export the TLS sessions in the cache of the pool, so that they can be imported after a restart
+         * Returns an empty list if it is not supported by the libcurl in use (see supportsTlsSessionExport).
+         * Session data is secret, it must be stored where only the application can read it
+         *
+         * @return Exported TLS sessions
+         */
+        [[nodiscard]] std::vector<TlsSession> exportTlsSessions() const
+        {
+            std::vector<TlsSession> sessions;
+
+#if LIBCURL_VERSION_NUM >= 0x080c00
+            CURL* handle = curl_easy_init();
+
+            if (!handle)
+            {
+                return sessions;
+            }
+
+            curl_easy_setopt(handle, CURLOPT_SHARE, share);
+
+            curl_easy_ssls_export(handle, exportTlsSession, &sessions);
+
+            curl_easy_cleanup(handle);
+#endif
+
+            return sessions;
+        }
+
+        /**
+         * @brief Import TLS sessions exported by exportTlsSessions into the cache of the pool
+         * Nothing is imported if it is not supported by the libcurl in use (see supportsTlsSessionExport)
+         *
+         * @param sessions: TLS sessions to be imported, expired sessions are skipped
+         * @return Number of imported sessions
+         */
+        size_t importTlsSessions(const std::vector<TlsSession>& sessions) noexcept
+        {
+            size_t imported = 0;
+
+#if LIBCURL_VERSION_NUM >= 0x080c00
+            CURL* handle = curl_easy_init();
+
+            if (!handle)
+            {
+                return imported;
+            }
+
+            curl_easy_setopt(handle, CURLOPT_SHARE, share);
+
+            const auto now = std::chrono::system_clock::now();
+
+            for (const auto& session : sessions)
+            {
+                if (session.validUntil <= now)
+                {
+                    continue;
+                }
+
+                const auto res = curl_easy_ssls_import(handle, session.key.empty() ? nullptr : session.key.c_str(),
+                                                       session.hmac.data(), session.hmac.size(), session.data.data(), session.data.size());
+
+                if (res == CURLE_OK)
+                {
+                    imported++;
+                }
+            }
+
+            curl_easy_cleanup(handle);
+#else
+            (void)sessions;
+#endif
+
+            return imported;
+        }
+
+        /**
+         * @brief Get the number of idle connections currently kept in the pool
+         *
+         * @return Number of idle connections for all hosts
+         */
+        [[nodiscard]] size_t idleConnectionCount() const noexcept
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            size_t count = 0;
+
+            for (const auto& host : idleHandles)
+            {
+                count += host.second.size();
+            }
+
+            return count;
+        }
+
+        /**
+         * @brief Close all idle connections in the pool
+         */
+        void clear() noexcept
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            for (auto& host : idleHandles)
+            {
+                for (auto& idle : host.second)
+                {
+                    curl_easy_cleanup(idle.handle);
+                }
+            }
+
+            idleHandles.clear();
+        }
+
+    private:
+        friend class HttpRequest;
+
+        struct IdleHandle
+        {
+            CURL* handle;
+            std::chrono::steady_clock::time_point releasedAt;
+        };
+
+        mutable std::mutex mutex;
+        std::map<std::string, std::deque<IdleHandle>> idleHandles;
+        std::atomic<int> maxIdleConnectionsPerHost;
+        std::atomic<int> idleTimeout;
+        std::atomic<int> dnsCacheTimeout{60};
+        CURLSH* share = nullptr;
+        std::array<std::mutex, CURL_LOCK_DATA_LAST> shareMutexes;
+        std::map<std::string, std::string> resolveOverrides;
+        std::vector<std::string> pendingResolveRemovals;
+
+#if LIBCURL_VERSION_NUM >= 0x080c00
+        static CURLcode exportTlsSession(CURL*, void* userData, const char* sessionKey, const unsigned char* hmac, const size_t hmacLength,
+                                         const unsigned char* data, const size_t dataLength, const curl_off_t validUntil, int, const char*, size_t)
+        {
+            auto* sessions = static_cast<std::vector<TlsSession>*>(userData);
+
+            TlsSession session;
+
+            session.key = sessionKey ? sessionKey : "";
+            session.hmac.assign(hmac, hmac + hmacLength);
+            session.data.assign(data, data + dataLength);
+            session.validUntil = std::chrono::system_clock::from_time_t(static_cast<std::time_t>(validUntil));
+
+            sessions->push_back(std::move(session));
+
+            return CURLE_OK;
+        }
+#endif
+
+        static void lockShare(CURL*, const curl_lock_data data, curl_lock_access, void* userData)
+        {
+            static_cast<ConnectionPool*>(userData)->shareMutexes[data].lock();
+        }
+
+        static void unlockShare(CURL*, const curl_lock_data data, void* userData)
+        {
+            static_cast<ConnectionPool*>(userData)->shareMutexes[data].unlock();
+        }
+
+        /**
+         * @brief Returns the resolve entries to be set to the next request in CURLOPT_RESOLVE format
+         */
+        std::vector<std::string> takeResolveEntries()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            std::vector<std::string> entries;
+
+            entries.swap(pendingResolveRemovals);
+
+            for (const auto& entry : resolveOverrides)
+            {
+                entries.push_back(entry.first + ":" + entry.second);
+            }
+
+            return entries;
+        }
+
+        /**
+         * @brief Returns the resolve overrides in CURLOPT_RESOLVE format
+         */
+        std::vector<std::string> resolveOverrideEntries() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            std::vector<std::string> entries;
+
+            for (const auto& entry : resolveOverrides)
+            {
+                entries.push_back(entry.first + ":" + entry.second);
+            }
+
+            return entries;
+        }
+
+        /**
+         * @brief Returns a plain HTTP URL with the host and port of the given URL, so that connecting to it doesn't start a TLS handshake
+         */
+        static std::string getConnectTarget(const std::string& url)
+        {
+            std::string target;
+
+            CURLU* parsed = curl_url();
+
+            if (!parsed)
+            {
+                return target;
+            }
+
+            char* host = nullptr;
+            char* port = nullptr;
+
+            if (curl_url_set(parsed, CURLUPART_URL, url.c_str(), CURLU_GUESS_SCHEME) == CURLUE_OK
+                && curl_url_get(parsed, CURLUPART_HOST, &host, 0) == CURLUE_OK
+                && curl_url_get(parsed, CURLUPART_PORT, &port, CURLU_DEFAULT_PORT) == CURLUE_OK)
+            {
+                target = std::string("http://") + host + ":" + port;
+            }
+
+            curl_free(host);
+            curl_free(port);
+            curl_url_cleanup(parsed);
+
+            return target;
+        }
+
+        CURL* acquire(const std::string& hostKey) noexcept
+        {
+            CURL* handle = nullptr;
+            std::vector<CURL*> expiredHandles;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                const auto host = idleHandles.find(hostKey);
+
+                if (host != idleHandles.end())
+                {
+                    const auto deadline = std::chrono::steady_clock::now() - std::chrono::seconds(idleTimeout.load());
+
+                    // Most recently used handles are at the back, so their connections are the least likely to be closed by the server
+                    while (!host->second.empty())
+                    {
+                        const auto idle = host->second.back();
+
+                        host->second.pop_back();
+
+                        if (idle.releasedAt >= deadline)
+                        {
+                            handle = idle.handle;
+
+                            break;
+                        }
+
+                        expiredHandles.push_back(idle.handle);
+                    }
+
+                    if (host->second.empty())
+                    {
+                        idleHandles.erase(host);
+                    }
+                }
+            }
+
+            for (auto* expired : expiredHandles)
+            {
+                curl_easy_cleanup(expired);
+            }
+
+            return handle ? handle : curl_easy_init();
+        }
+
+        void release(const std::string& hostKey, CURL* handle) noexcept
+        {
+            curl_easy_reset(handle);
+
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto& host = idleHandles[hostKey];
+
+            if (static_cast<int>(host.size()) >= maxIdleConnectionsPerHost.load())
+            {
+                if (host.empty())
+                {
+                    idleHandles.erase(hostKey);
+                }
+
+                curl_easy_cleanup(handle);
+
+                return;
+            }
+
+            host.push_back({handle, std::chrono::steady_clock::now()});
+        }
+    };
+
+    /**
+     * @brief Interface for the executors that can run the requests sent by HttpRequest::send(executor)
+     */
+    class Executor
+    {
+    public:
+        virtual ~Executor() = default;
+
+        /**
+         * @brief Run the given task asynchronously
+         *
+         * @param task: Task to be run
+         *
+         * @return false if the task is not accepted by the executor
+         */
+        virtual bool execute(std::function<void()> task) noexcept = 0;
+    };
+
+    /**
+     * @brief Behavior of ThreadPoolExecutor when its work queue is full
+     */
+    enum class QueueFullPolicy
+    {
+        BLOCK, /* Wait until there is room in the queue */
+        FAIL /* Complete the request immediately with an error */
+    };
+
+    /**
+     * @brief Executor with a fixed number of worker threads and a bounded work queue
+     */
+    class ThreadPoolExecutor : public Executor
+    {
+    public:
+        /**
+         * @brief Constructor for the ThreadPoolExecutor class
+         *
+         * @param threadCount: Number of worker threads (at least 1)
+         * @param queueCapacity: Maximum number of tasks waiting in the queue (at least 1)
+         * @param queueFullPolicy: What to do when a task is submitted while the queue is full
+         */
+        explicit ThreadPoolExecutor(const int threadCount = 4, const size_t queueCapacity = 1024, const QueueFullPolicy queueFullPolicy = QueueFullPolicy::BLOCK)
+            : queueCapacity(std::max<size_t>(queueCapacity, 1)), queueFullPolicy(queueFullPolicy)
+        {
+            for (int i = 0; i < std::max(threadCount, 1); i++)
+            {
+                workers.emplace_back([this]
+                {
+                    work();
+                });
+            }
+        }
+
+        /**
+         * @brief Runs the tasks remaining in the queue and stops the worker threads
+         */
+        ~ThreadPoolExecutor() override
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                stopping = true;
+            }
+
+            taskAvailable.notify_all();
+            spaceAvailable.notify_all();
+
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
+        }
+
+        ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+
+        ThreadPoolExecutor& operator=(const ThreadPoolExecutor&) = delete;
+
+        bool execute(std::function<void()> task) noexcept override
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+
+                if (queueFullPolicy == QueueFullPolicy::BLOCK)
+                {
+                    spaceAvailable.wait(lock, [this]
+                    {
+                        return stopping || tasks.size() < queueCapacity;
+                    });
+                }
+
+                if (stopping || tasks.size() >= queueCapacity)
+                {
+                    return false;
+                }
+
+                tasks.push_back(std::move(task));
+            }
+
+            taskAvailable.notify_one();
+
+            return true;
+        }
+
+        /**
+         * @brief Get the number of tasks waiting in the queue
+         *
+         * @return Number of queued tasks
+         */
+        [[nodiscard]] size_t queueSize() const noexcept
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            return tasks.size();
+        }
+
+    private:
+        const size_t queueCapacity;
+        const QueueFullPolicy queueFullPolicy;
+        mutable std::mutex mutex;
+        std::condition_variable taskAvailable;
+        std::condition_variable spaceAvailable;
+        std::deque<std::function<void()>> tasks;
+        std::vector<std::thread> workers;
+        bool stopping = false;
+
+        void work() noexcept
+        {
+            while (true)
+            {
+                std::function<void()> task;
+
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+
+                    taskAvailable.wait(lock, [this]
+                    {
+                        return stopping || !tasks.empty();
+                    });
+
+                    if (tasks.empty())
+                    {
+                        return;
+                    }
+
+                    task = std::move(tasks.front());
+
+                    tasks.pop_front();
+                }
+
+                spaceAvailable.notify_one();
+
+                task();
+            }
+        }
+    };
+
+    /**
+     * @brief Token to cancel the requests that it is set to, copies of a token share the same state
+     * Requests sent through an HttpClient are aborted immediately, others are aborted at the next progress
+     * check of the transfer, which happens at least once a second
+     */
+    class CancellationToken
+    {
+    public:
+        CancellationToken() : state(std::make_shared<State>())
+        {
+        }
+
+        /**
+         * @brief Cancel the requests that the token is set to, they complete with "Request is cancelled" error
+         */
+        void cancel() noexcept
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+
+            if (state->cancelled.exchange(true))
+            {
+                return;
+            }
+
+            // Callbacks are called under the lock, so that no callback is called after it is unsubscribed
+            for (auto& callback : state->callbacks)
+            {
+                callback.second();
+            }
+
+            state->callbacks.clear();
+        }
+
+        /**
+         * @brief Returns whether the token is cancelled
+         */
+        [[nodiscard]] bool isCancelled() const noexcept
+        {
+            return state->cancelled.load();
+        }
+
+    private:
+        friend class HttpRequest;
+        friend class HttpClient;
+
+        struct State
+        {
+            std::atomic<bool> cancelled{false};
+            std::mutex mutex;
+            std::map<size_t, std::function<void()>> callbacks;
+            size_t nextId = 1;
+        };
+
+        std::shared_ptr<State> state;
+
+        /**
+         * @brief Register a callback to be called when the token is cancelled, it is called immediately if it is already cancelled
+         *
+         * @return Id to unsubscribe the callback, 0 if it is already called
+         */
+        size_t subscribe(std::function<void()> callback) const
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+
+            if (state->cancelled.load())
+            {
+                callback();
+
+                return 0;
+            }
+
+            const auto id = state->nextId++;
+
+            state->callbacks.emplace(id, std::move(callback));
+
+            return id;
+        }
+
+        void unsubscribe(const size_t id) const noexcept
+        {
+            if (id == 0)
+            {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+
+            state->callbacks.erase(id);
+        }
+    };
+
+    /**
+     * @brief Point in time copy of a LatencyHistogram
+     */
+    struct LatencyHistogramSnapshot
+    {
+        /**
+         * @brief Number of recorded latencies in each bucket
+         */
+        std::vector<uint64_t> buckets;
+
+        /**
+         * @brief Number of recorded latencies
+         */
+        uint64_t count = 0;
+
+        /**
+         * @brief Sum of recorded latencies in microseconds
+         */
+        uint64_t sum = 0;
+
+        /**
+         * @brief Returns the latency that the given ratio of the recorded latencies are below
+         *
+         * @param quantile: Ratio between 0 and 1 (0.99 for p99)
+         */
+        [[nodiscard]] std::chrono::microseconds percentile(const double quantile) const noexcept;
+    };
+
+    /**
+     * @brief Lock-free histogram of latencies with log-linear (HDR style) buckets
+     * Every power of two range is divided into 8 linear buckets, so the relative error is below 12.5%
+     */
+    class LatencyHistogram
+    {
+    public:
+        static constexpr size_t subBucketBits = 3;
+        static constexpr size_t subBucketCount = size_t(1) << subBucketBits;
+        static constexpr size_t maxExponent = 40;
+        static constexpr size_t bucketCount = subBucketCount + (maxExponent - subBucketBits + 1) * subBucketCount;
+
+        /**
+         * @brief Record a latency
+         *
+         * @param latency: Latency to be recorded
+         */
+        void record(const std::chrono::microseconds latency) noexcept
+        {
+            const auto value = static_cast<uint64_t>(std::max<long long>(latency.count(), 0));
+
+            buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+            total.fetch_add(1, std::memory_order_relaxed);
+            sum.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Returns the number of recorded latencies
+         */
+        [[nodiscard]] uint64_t count() const noexcept
+        {
+            return total.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Returns the latency that the given ratio of the recorded latencies are below
+         *
+         * @param quantile: Ratio between 0 and 1 (0.99 for p99)
+         */
+        [[nodiscard]] std::chrono::microseconds percentile(const double quantile) const
+        {
+            return snapshot().percentile(quantile);
+        }
+
+        /**
+         * @brief Returns a copy of the current bucket counts
+         */
+        [[nodiscard]] LatencyHistogramSnapshot snapshot() const
+        {
+            LatencyHistogramSnapshot result;
+
+            result.buckets.resize(bucketCount);
+
+            for (size_t i = 0; i < bucketCount; i++)
+            {
+                result.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+                result.count += result.buckets[i];
+            }
+
+            result.sum = sum.load(std::memory_order_relaxed);
+
+            return result;
+        }
+
+        /**
+         * @brief Returns the largest latency in microseconds that falls into the given bucket
+         *
+         * @param index: Index of the bucket
+         */
+        static uint64_t bucketUpperBound(const size_t index) noexcept
+        {
+            if (index < subBucketCount)
+            {
+                return index;
+            }
+
+            const auto exponent = subBucketBits + (index - subBucketCount) / subBucketCount;
+            const auto subBucket = (index - subBucketCount) % subBucketCount;
+
+            return ((subBucketCount + subBucket + 1) << (exponent - subBucketBits)) - 1;
+        }
+
+    private:
+        std::array<std::atomic<uint64_t>, bucketCount> buckets{};
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> sum{0};
+
+        static size_t bucketIndex(const uint64_t value) noexcept
+        {
+            if (value < subBucketCount)
+            {
+                return static_cast<size_t>(value);
+            }
+
+            if ((value >> (maxExponent + 1)) != 0)
+            {
+                return bucketCount - 1;
+            }
+
+            size_t exponent = subBucketBits;
+
+            while ((value >> (exponent + 1)) != 0)
+            {
+                exponent++;
+            }
+
+            const auto subBucket = static_cast<size_t>(value >> (exponent - subBucketBits)) & (subBucketCount - 1);
+
+            return subBucketCount + (exponent - subBucketBits) * subBucketCount + subBucket;
+        }
+    };
+
+    inline std::chrono::microseconds LatencyHistogramSnapshot::percentile(const double quantile) const noexcept
+    {
+        if (count == 0)
+        {
+            return std::chrono::microseconds(0);
+        }
+
+        const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(quantile, 0.0, 1.0) * static_cast<double>(count))));
+
+        uint64_t seen = 0;
+
+        for (size_t i = 0; i < buckets.size(); i++)
+        {
+            seen += buckets[i];
+
+            if (seen >= rank)
+            {
+                return std::chrono::microseconds(LatencyHistogram::bucketUpperBound(i));
+            }
+        }
+
+        return std::chrono::microseconds(LatencyHistogram::bucketUpperBound(buckets.size() - 1));
+    }
+
+    /**
+     * @brief Request counts and latencies of a host, method and status class combination
+     */
+    struct HttpMetricsSeries
+    {
+        std::string host;
+        std::string method;
+        std::string statusClass; /* "2xx", "4xx" etc. or "none" if no response is received */
+        LatencyHistogramSnapshot latency;
+    };
+
+    /**
+     * @brief Point in time copy of the values in HttpMetrics
+     */
+    struct HttpMetricsSnapshot
+    {
+        std::vector<HttpMetricsSeries> series;
+        uint64_t requestsInFlight = 0;
+        uint64_t connectionsOpened = 0;
+        uint64_t connectionsReused = 0;
+        uint64_t bytesSent = 0;
+        uint64_t bytesReceived = 0;
+
+        /**
+         * @brief Number of failed transfers by CURLcode
+         */
+        std::map<int, uint64_t> errors;
+
+        /**
+         * @brief Render the values in OpenMetrics (Prometheus) text format
+         */
+        [[nodiscard]] std::string toOpenMetrics() const
+        {
+            std::ostringstream out;
+
+            out << "# TYPE http_client_requests counter\n";
+            out << "# HELP http_client_requests Completed requests.\n";
+
+            for (const auto& item : series)
+            {
+                out << "http_client_requests_total{" << labels(item) << "} " << item.latency.count << "\n";
+            }
+
+            out << "# TYPE http_client_request_duration_seconds histogram\n";
+            out << "# HELP http_client_request_duration_seconds Total time of completed requests.\n";
+
+            for (const auto& item : series)
+            {
+                const auto itemLabels = labels(item);
+
+                uint64_t cumulative = 0;
+
+                for (size_t i = 0; i < item.latency.buckets.size(); i++)
+                {
+                    if (item.latency.buckets[i] == 0)
+                    {
+                        continue;
+                    }
+
+                    cumulative += item.latency.buckets[i];
+
+                    out << "http_client_request_duration_seconds_bucket{" << itemLabels << ",le=\"" << seconds(LatencyHistogram::bucketUpperBound(i)) << "\"} " << cumulative << "\n";
+                }
+
+                out << "http_client_request_duration_seconds_bucket{" << itemLabels << ",le=\"+Inf\"} " << item.latency.count << "\n";
+                out << "http_client_request_duration_seconds_count{" << itemLabels << "} " << item.latency.count << "\n";
+                out << "http_client_request_duration_seconds_sum{" << itemLabels << "} " << seconds(item.latency.sum) << "\n";
+            }
+
+            out << "# TYPE http_client_requests_in_flight gauge\n";
+            out << "# HELP http_client_requests_in_flight Requests being transferred.\n";
+            out << "http_client_requests_in_flight " << requestsInFlight << "\n";
+
+            out << "# TYPE http_client_connections counter\n";
+            out << "# HELP http_client_connections Requests that opened a new connection or reused an existing one.\n";
+            out << "http_client_connections_total{state=\"opened\"} " << connectionsOpened << "\n";
+            out << "http_client_connections_total{state=\"reused\"} " << connectionsReused << "\n";
+
+            out << "# TYPE http_client_bytes counter\n";
+            out << "# HELP http_client_bytes Payload and response body bytes.\n";
+            out << "http_client_bytes_total{direction=\"sent\"} " << bytesSent << "\n";
+            out << "http_client_bytes_total{direction=\"received\"} " << bytesReceived << "\n";
+
+            out << "# TYPE http_client_errors counter\n";
+            out << "# HELP http_client_errors Failed transfers by CURLcode.\n";
+
+            for (const auto& error : errors)
+            {
+                out << "http_client_errors_total{code=\"" << error.first << "\"} " << error.second << "\n";
+            }
+
+            out << "# EOF\n";
+
+            return out.str();
+        }
+
+    private:
+        static std::string labels(const HttpMetricsSeries& item)
+        {
+            return "host=\"" + escape(item.host) + "\",method=\"" + escape(item.method) + "\",status_class=\"" + item.statusClass + "\"";
+        }
+
+        static std::string escape(const std::string& value)
+        {
+            std::string output;
+
+            for (const char c : value)
+            {
+                if (c == '\\' || c == '"')
+                {
+                    output += '\\';
+                    output += c;
+                }
+                else if (c == '\n')
+                {
+                    output += "\\n";
+                }
+                else
+                {
+                    output += c;
+                }
+            }
+
+            return output;
+        }
+
+        static std::string seconds(const uint64_t microseconds)
+        {
+            char buffer[32];
+
+            std::snprintf(buffer, sizeof(buffer), "%.6f", static_cast<double>(microseconds) / 1000000.0);
+
+            return buffer;
+        }
+    };
+
+    /**
+     * @brief Registry of counters and latency histograms of the requests that it is set to
+     * Counters are sharded per thread and updated without locks, so it can be shared by all requests and clients
+     */
+    class HttpMetrics
+    {
+    public:
+        HttpMetrics() = default;
+
+        HttpMetrics(const HttpMetrics&) = delete;
+
+        HttpMetrics& operator=(const HttpMetrics&) = delete;
+
+        /**
+         * @brief Returns a copy of the current values
+         */
+        [[nodiscard]] HttpMetricsSnapshot snapshot() const
+        {
+            HttpMetricsSnapshot result;
+
+            {
+                std::shared_lock<std::shared_mutex> lock(mutex);
+
+                for (const auto& entry : series)
+                {
+                    result.series.push_back({std::get<0>(entry.first), std::get<1>(entry.first), std::get<2>(entry.first), entry.second->snapshot()});
+                }
+            }
+
+            const auto startedCount = started.load();
+            const auto finishedCount = finished.load();
+
+            result.requestsInFlight = startedCount > finishedCount ? startedCount - finishedCount : 0;
+            result.connectionsOpened = connectionsOpened.load();
+            result.connectionsReused = connectionsReused.load();
+            result.bytesSent = bytesSent.load();
+            result.bytesReceived = bytesReceived.load();
+
+            for (size_t i = 0; i < errors.size(); i++)
+            {
+                const auto count = errors[i].load(std::memory_order_relaxed);
+
+                if (count > 0)
+                {
+                    result.errors[static_cast<int>(i)] = count;
+                }
+            }
+
+            return result;
+        }
+
+        /**
+         * @brief Render the current values in OpenMetrics (Prometheus) text format
+         */
+        [[nodiscard]] std::string toOpenMetrics() const
+        {
+            return snapshot().toOpenMetrics();
+        }
+
+    private:
+        friend class HttpRequest;
+        friend class HttpClient;
+
+        /**
+         * @brief Counter spread over cache line aligned shards, so that threads don't contend on the same cache line
+         */
+        class ShardedCounter
+        {
+        public:
+            void add(const uint64_t value) noexcept
+            {
+                shards[shardIndex()].value.fetch_add(value, std::memory_order_relaxed);
+            }
+
+            [[nodiscard]] uint64_t load() const noexcept
+            {
+                uint64_t total = 0;
+
+                for (const auto& shard : shards)
+                {
+                    total += shard.value.load(std::memory_order_relaxed);
+                }
+
+                return total;
+            }
+
+        private:
+            static constexpr size_t shardCount = 16;
+
+            struct alignas(64) Shard
+            {
+                std::atomic<uint64_t> value{0};
+            };
+
+            std::array<Shard, shardCount> shards;
+
+            static size_t shardIndex() noexcept
+            {
+                static thread_local const size_t index = std::hash<std::thread::id>()(std::this_thread::get_id()) % shardCount;
+
+                return index;
+            }
+        };
+
+        using SeriesKey = std::tuple<std::string, std::string, std::string>;
+
+        mutable std::shared_mutex mutex;
+        std::map<SeriesKey, std::unique_ptr<LatencyHistogram>> series;
+        ShardedCounter started;
+        ShardedCounter finished;
+        ShardedCounter connectionsOpened;
+        ShardedCounter connectionsReused;
+        ShardedCounter bytesSent;
+        ShardedCounter bytesReceived;
+        std::array<std::atomic<uint64_t>, CURL_LAST> errors{};
+
+        void transferStarted() noexcept
+        {
+            started.add(1);
+        }
+
+        void transferStopped() noexcept
+        {
+            finished.add(1);
+        }
+
+        void transferFinished(CURL* handle, std::string host, std::string method, const long statusCode, const CURLcode res) noexcept
+        {
+            curl_off_t total = 0, uploaded = 0, downloaded = 0;
+            long newConnections = 0;
+
+            curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME_T, &total);
+            curl_easy_getinfo(handle, CURLINFO_SIZE_UPLOAD_T, &uploaded);
+            curl_easy_getinfo(handle, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+            curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &newConnections);
+
+            std::string statusClass = statusCode >= 100 && statusCode < 600 ? std::to_string(statusCode / 100) + "xx" : "none";
+
+            seriesFor(SeriesKey(std::move(host), std::move(method), std::move(statusClass))).record(std::chrono::microseconds(total));
+
+            if (newConnections > 0)
+            {
+                connectionsOpened.add(static_cast<uint64_t>(newConnections));
+            }
+            else if (statusCode != 0)
+            {
+                connectionsReused.add(1);
+            }
+
+            bytesSent.add(static_cast<uint64_t>(uploaded));
+            bytesReceived.add(static_cast<uint64_t>(downloaded));
+
+            if (res != CURLE_OK && static_cast<size_t>(res) < errors.size())
+            {
+                errors[static_cast<size_t>(res)].fetch_add(1, std::memory_order_relaxed);
+            }
+
+            finished.add(1);
+        }
+
+        LatencyHistogram& seriesFor(SeriesKey&& key)
+        {
+            {
+                std::shared_lock<std::shared_mutex> lock(mutex);
+
+                const auto found = series.find(key);
+
+                if (found != series.end())
+                {
+                    return *found->second;
+                }
+            }
+
+            std::unique_lock<std::shared_mutex> lock(mutex);
+
+            auto& histogram = series[std::move(key)];
+
+            if (!histogram)
+            {
+                histogram = std::make_unique<LatencyHistogram>();
+            }
+
+            return *histogram;
+        }
+    };
+
+    /**
+     * @brief Settings of hedged requests, which are duplicates of a slow request sent to the same or another
+     * replica after a delay. The first successful response wins and the other attempts are cancelled
+     * Copies of a policy share the latencies they observe, so one policy can be set to many requests
+     */
+    class HedgingPolicy
+    {
+    public:
+        /**
+         * @brief Set the maximum number of attempts including the original request
+         *
+         * @param maxAttempts: Maximum number of attempts (at least 1, default 2)
+         */
+        HedgingPolicy& setMaxAttempts(const int maxAttempts) noexcept
+        {
+            this->maxAttempts = std::max(maxAttempts, 1);
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the fixed delay before the next attempt is sent
+         * If a percentile delay is set, this delay is used until enough latencies are observed
+         *
+         * @param delay: Delay between the attempts (default 50 ms)
+         */
+        HedgingPolicy& setDelay(const std::chrono::milliseconds delay) noexcept
+        {
+            this->delay = std::max(delay, std::chrono::milliseconds(0));
+
+            return *this;
+        }
+
+        /**
+         * @brief Send the next attempt when the request takes longer than the given percentile of the observed latencies
+         *
+         * @param quantile: Ratio between 0 and 1 (0.95 for p95)
+         * @param minSamples: Number of successful attempts to observe before the percentile is used instead of the fixed delay
+         */
+        HedgingPolicy& setPercentileDelay(const double quantile, const uint64_t minSamples = 20) noexcept
+        {
+            this->quantile = std::clamp(quantile, 0.0, 1.0);
+            this->minSamples = minSamples;
+
+            return *this;
+        }
+
+        /**
+         * @brief Add a URL that the hedged attempts will be sent to, the URLs are used in turn
+         * If no URL is added, the hedged attempts are sent to the URL of the request
+         *
+         * @param url: URL of another replica, query string included
+         */
+        HedgingPolicy& addAlternateUrl(const std::string& url) noexcept
+        {
+            this->alternateUrls.push_back(url);
+
+            return *this;
+        }
+
+        /**
+         * @brief Returns the latencies of the successful attempts sent with the policy
+         */
+        [[nodiscard]] const LatencyHistogram& getLatencies() const noexcept
+        {
+            return *latencies;
+        }
+
+        /**
+         * @brief Returns the delay that the next attempt will be sent after
+         */
+        [[nodiscard]] std::chrono::milliseconds getDelay() const
+        {
+            if (quantile > 0 && latencies->count() >= std::max<uint64_t>(minSamples, 1))
+            {
+                return std::chrono::ceil<std::chrono::milliseconds>(latencies->percentile(quantile));
+            }
+
+            return delay;
+        }
+
+    private:
+        friend class HttpClient;
+
+        int maxAttempts = 2;
+        std::chrono::milliseconds delay{50};
+        double quantile = 0;
+        uint64_t minSamples = 20;
+        std::vector<std::string> alternateUrls;
+        std::shared_ptr<LatencyHistogram> latencies = std::make_shared<LatencyHistogram>();
+
+        [[nodiscard]] const std::string& urlFor(const int attempt, const std::string& url) const noexcept
+        {
+            if (attempt == 0 || alternateUrls.empty())
+            {
+                return url;
+            }
+
+            return alternateUrls[(attempt - 1) % alternateUrls.size()];
+        }
+    };
+
+    /**
+     * @brief Token bucket that limits the retries of the requests sharing it, so that retries cannot multiply the load on a failing server
+     * Every request adds retryRatio tokens, minRetriesPerSecond tokens are added every second and every retry takes one token
+     */
+    class RetryBudget
+    {
+    public:
+        /**
+         * @brief Constructor for the RetryBudget class
+         *
+         * @param retryRatio: Tokens added by every request (0.1 allows one retry for every 10 requests)
+         * @param minRetriesPerSecond: Tokens added every second, so that requests can be retried under low traffic
+         * @param capacity: Maximum number of tokens that can be saved up, the bucket is full at the beginning
+         */
+        explicit RetryBudget(const double retryRatio = 0.1, const double minRetriesPerSecond = 10, const double capacity = 100)
+            : retryRatio(std::max(retryRatio, 0.0)), minRetriesPerSecond(std::max(minRetriesPerSecond, 0.0)), capacity(std::max(capacity, 1.0)), tokens(this->capacity)
+        {
+        }
+
+        RetryBudget(const RetryBudget&) = delete;
+
+        RetryBudget& operator=(const RetryBudget&) = delete;
+
+        /**
+         * @brief Returns the number of retries that can be made now
+         */
+        [[nodiscard]] double available() const noexcept
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            return refilled(std::chrono::steady_clock::now());
+        }
+
+    private:
+        friend class RetryPolicy;
+
+        const double retryRatio;
+        const double minRetriesPerSecond;
+        const double capacity;
+        mutable std::mutex mutex;
+        double tokens;
+        std::chrono::steady_clock::time_point refilledAt = std::chrono::steady_clock::now();
+
+        void deposit() noexcept
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            refill();
+
+            tokens = std::min(tokens + retryRatio, capacity);
+        }
+
+        bool withdraw() noexcept
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            refill();
+
+            if (tokens < 1)
+            {
+                return false;
+            }
+
+            tokens -= 1;
+
+            return true;
+        }
+
+        void refill() noexcept
+        {
+            const auto now = std::chrono::steady_clock::now();
+
+            tokens = refilled(now);
+            refilledAt = now;
+        }
+
+        [[nodiscard]] double refilled(const std::chrono::steady_clock::time_point now) const noexcept
+        {
+            const std::chrono::duration<double> elapsed = now - refilledAt;
+
+            return std::min(tokens + elapsed.count() * minRetriesPerSecond, capacity);
+        }
+    };
+
+    /**
+     * @brief Settings of automatic retries of failed requests with exponential backoff and full jitter
+     * Requests that are not idempotent (POST and PATCH without an "Idempotency-Key" header) are retried only
+     * if they could not be sent at all. Copies of a policy share the same retry budget
+     */
+    class RetryPolicy
+    {
+    public:
+        /**
+         * @brief Set the maximum number of attempts including the original request
+         *
+         * @param maxAttempts: Maximum number of attempts (at least 1, default 3)
+         */
+        RetryPolicy& setMaxAttempts(const int maxAttempts) noexcept
+        {
+            this->maxAttempts = std::max(maxAttempts, 1);
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the backoff between the attempts, the delay before the nth retry is random between 0 and
+         * min(maxDelay, initialDelay * 2^n)
+         *
+         * @param initialDelay: Upper limit of the delay before the first retry (default 100 ms)
+         * @param maxDelay: Upper limit of the delay before any retry (default 10 seconds)
+         */
+        RetryPolicy& setBackoff(const std::chrono::milliseconds initialDelay, const std::chrono::milliseconds maxDelay) noexcept
+        {
+            this->initialDelay = std::max(initialDelay, std::chrono::milliseconds(0));
+            this->maxDelay = std::max(maxDelay, this->initialDelay);
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the HTTP status codes that the request is retried for
+         *
+         * @param statusCodes: Status codes (default 408, 429, 500, 502, 503 and 504)
+         */
+        RetryPolicy& setRetryableStatusCodes(std::vector<int> statusCodes) noexcept
+        {
+            this->statusCodes = std::move(statusCodes);
+
+            return *this;
+        }
+
+        /**
+         * @brief Set whether the request is retried if the host could not be resolved or connected to (default true)
+         *
+         * @param retry: Retry on connection errors or not
+         */
+        RetryPolicy& setRetryOnConnectionErrors(const bool retry) noexcept
+        {
+            this->retryOnConnectionErrors = retry;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set whether the request is retried if it times out (default true)
+         *
+         * @param retry: Retry on timeouts or not
+         */
+        RetryPolicy& setRetryOnTimeouts(const bool retry) noexcept
+        {
+            this->retryOnTimeouts = retry;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set whether the request is retried if the connection is broken while it is being sent or received (default true)
+         *
+         * @param retry: Retry on transfer errors or not
+         */
+        RetryPolicy& setRetryOnTransferErrors(const bool retry) noexcept
+        {
+            this->retryOnTransferErrors = retry;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set whether requests that are not idempotent are retried after they may have reached the server (default false)
+         *
+         * @param retry: Retry non-idempotent requests or not
+         */
+        RetryPolicy& setRetryNonIdempotent(const bool retry) noexcept
+        {
+            this->retryNonIdempotent = retry;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the longest "Retry-After" delay that is waited, the response is returned if the server asks for more
+         *
+         * @param maxRetryAfter: Longest delay to wait (default 30 seconds)
+         */
+        RetryPolicy& setMaxRetryAfter(const std::chrono::milliseconds maxRetryAfter) noexcept
+        {
+            this->maxRetryAfter = maxRetryAfter;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the retry budget, the same budget can be shared by many policies to limit the retries of a whole client
+         *
+         * @param budget: Retry budget (nullptr for no limit)
+         */
+        RetryPolicy& setBudget(std::shared_ptr<RetryBudget> budget) noexcept
+        {
+            this->budget = std::move(budget);
+
+            return *this;
+        }
+
+        /**
+         * @brief Returns the retry budget of the policy
+         */
+        [[nodiscard]] std::shared_ptr<RetryBudget> getBudget() const noexcept
+        {
+            return budget;
+        }
+
+    private:
+        friend class HttpRequest;
+        friend class HttpClient;
+
+        int maxAttempts = 3;
+        std::chrono::milliseconds initialDelay{100};
+        std::chrono::milliseconds maxDelay{10000};
+        std::vector<int> statusCodes = {408, 429, 500, 502, 503, 504};
+        bool retryOnConnectionErrors = true;
+        bool retryOnTimeouts = true;
+        bool retryOnTransferErrors = true;
+        bool retryNonIdempotent = false;
+        std::chrono::milliseconds maxRetryAfter{30000};
+        std::shared_ptr<RetryBudget> budget = std::make_shared<RetryBudget>();
+
+        void requestStarted() const noexcept
+        {
+            if (budget)
+            {
+                budget->deposit();
+            }
+        }
+
+        /**
+         * @brief Returns the delay before the next attempt, nothing if the result must be returned as it is
+         *
+         * @param result: Result of the last attempt
+         * @param retries: Number of retries made so far
+         * @param idempotent: Whether the request can be sent more than once
+         * @param deadline: Deadline of the request, if any
+         */
+        std::optional<std::chrono::milliseconds> nextDelay(const HttpResult& result, const int retries, const bool idempotent, const std::optional<std::chrono::steady_clock::time_point>& deadline) const noexcept
+        {
+            if (result.succeed || retries + 1 >= maxAttempts)
+            {
+                return std::nullopt;
+            }
+
+            bool retryable = false;
+            bool requestSent = true;
+
+            switch (result.curlCode)
+            {
+            case CURLE_OK:
+                retryable = std::find(statusCodes.begin(), statusCodes.end(), result.statusCode) != statusCodes.end();
+                break;
+            case CURLE_COULDNT_RESOLVE_PROXY:
+            case CURLE_COULDNT_RESOLVE_HOST:
+            case CURLE_COULDNT_CONNECT:
+            case CURLE_SSL_CONNECT_ERROR:
+                retryable = retryOnConnectionErrors;
+                requestSent = false;
+                break;
+            case CURLE_OPERATION_TIMEDOUT:
+                retryable = retryOnTimeouts;
+                break;
+            case CURLE_SEND_ERROR:
+            case CURLE_RECV_ERROR:
+            case CURLE_GOT_NOTHING:
+            case CURLE_PARTIAL_FILE:
+            case CURLE_HTTP2:
+            case CURLE_HTTP2_STREAM:
+                retryable = retryOnTransferErrors;
+                break;
+            default:
+                break;
+            }
+
+            if (!retryable || (requestSent && !idempotent && !retryNonIdempotent))
+            {
+                return std::nullopt;
+            }
+
+            auto delay = backoff(retries);
+
+            if (result.curlCode == CURLE_OK)
+            {
+                const auto retryAfter = parseRetryAfter(result.headers.get("Retry-After"));
+
+                if (retryAfter)
+                {
+                    if (*retryAfter > maxRetryAfter)
+                    {
+                        return std::nullopt;
+                    }
+
+                    delay = *retryAfter;
+                }
+            }
+
+            if (deadline && std::chrono::steady_clock::now() + delay >= *deadline)
+            {
+                return std::nullopt;
+            }
+
+            // Budget is checked last, so that no token is spent for a retry that is not made
+            if (budget && !budget->withdraw())
+            {
+                return std::nullopt;
+            }
+
+            return delay;
+        }
+
+        std::chrono::milliseconds backoff(const int retries) const
+        {
+            const auto limit = std::min(static_cast<double>(initialDelay.count()) * std::ldexp(1.0, std::min(retries, 30)), static_cast<double>(maxDelay.count()));
+
+            thread_local std::mt19937_64 generator{std::random_device{}()};
+
+            std::uniform_int_distribution<long long> distribution(0, static_cast<long long>(limit));
+
+            return std::chrono::milliseconds(distribution(generator));
+        }
+
+        static std::optional<std::chrono::milliseconds> parseRetryAfter(const std::string_view value)
+        {
+            if (value.empty())
+            {
+                return std::nullopt;
+            }
+
+            if (std::all_of(value.begin(), value.end(), [](const unsigned char c) { return std::isdigit(c); }))
+            {
+                // The value comes from the server, longer ones than any sensible delay must not overflow
+                if (value.size() > 9)
+                {
+                    return std::chrono::milliseconds::max();
+                }
+
+                return toMilliseconds(std::stoll(std::string(value)));
+            }
+
+            // Otherwise it is an HTTP date
+            const auto date = curl_getdate(std::string(value).c_str(), nullptr);
+
+            if (date < 0)
+            {
+                return std::nullopt;
+            }
+
+            return toMilliseconds(std::max<long long>(static_cast<long long>(date) - static_cast<long long>(std::time(nullptr)), 0));
+        }
+
+        /**
+         * @brief Convert seconds to milliseconds, saturating instead of overflowing
+         */
+        static std::chrono::milliseconds toMilliseconds(const long long seconds) noexcept
+        {
+            if (seconds > std::chrono::milliseconds::max().count() / 1000)
+            {
+                return std::chrono::milliseconds::max();
+            }
+
+            return std::chrono::seconds(seconds);
+        }
+    };
+
+    /**
+     * @brief Statistics of an HttpCache
+     */
+    struct HttpCacheStatistics
+    {
+        /**
+         * @brief Number of requests served from the cache without contacting the server
+         */
+        size_t hits = 0;
+
+        /**
+         * @brief Number of requests served with a stale response while it is revalidated in the background
+         */
+        size_t staleHits = 0;
+
+        /**
+         * @brief Number of requests sent to the server because no usable response was stored
+         */
+        size_t misses = 0;
+
+        /**
+         * @brief Number of stored responses confirmed by the server with "304 Not Modified"
+         */
+        size_t revalidations = 0;
+
+        /**
+         * @brief Number of responses stored
+         */
+        size_t stores = 0;
+
+        /**
+         * @brief Number of responses removed from the memory to make room for new ones
+         */
+        size_t evictions = 0;
+
+        /**
+         * @brief Number of responses and their total size in bytes kept in the memory
+         */
+        size_t memoryEntries = 0;
+        size_t memoryBytes = 0;
+
+        /**
+         * @brief Number of responses and their total size in bytes kept on the disk
+         */
+        size_t diskEntries = 0;
+        size_t diskBytes = 0;
+
+        /**
+         * @brief Ratio of the requests served from the cache to all requests looked up in the cache
+         */
+        [[nodiscard]] double hitRate() const noexcept
+        {
+            const auto served = hits + staleHits;
+
+            return served + misses == 0 ? 0.0 : static_cast<double>(served) / static_cast<double>(served + misses);
+        }
+    };
+
+    /**
+     * @brief Private HTTP cache that GET responses are served from, following the rules of RFC 9111
+     * Responses are kept in a sharded in-memory LRU bounded by bytes and optionally on the disk as well.
+     * Freshness is calculated from Cache-Control, Expires and Age, the Vary header is honored, stale
+     * responses are revalidated with conditional requests (ETag and Last-Modified) and stale-while-revalidate
+     * is supported. The same cache can be shared by any number of requests and clients
+     */
+    class HttpCache
+    {
+    public:
+        /**
+         * @brief Constructor for the HttpCache class
+         *
+         * @param maxMemoryBytes: Maximum total size of the responses kept in the memory
+         * @param shardCount: Number of independently locked parts the memory is split into, each gets an equal share of maxMemoryBytes
+         */
+        explicit HttpCache(const size_t maxMemoryBytes = 64 * 1024 * 1024, const size_t shardCount = 16)
+            : shards(std::max<size_t>(shardCount, 1)), maxShardBytes(maxMemoryBytes / std::max<size_t>(shardCount, 1))
+        {
+        }
+
+        /**
+         * @brief Writes the responses still waiting to be written to the disk and stops the writer thread
+         */
+        ~HttpCache()
+        {
+            {
+                std::lock_guard<std::mutex> lock(writeMutex);
+
+                stopping = true;
+            }
+
+            writeAvailable.notify_all();
+
+            if (writer.joinable())
+            {
+                writer.join();
+            }
+        }
+
+        HttpCache(const HttpCache&) = delete;
+
+        HttpCache& operator=(const HttpCache&) = delete;
+
+        /**
+         * @brief Keep the responses on the disk as well, so more of them can be kept and they survive restarts
+         * Every response is written to its own file with the body at the end, so it can be read or mapped at once.
+         * Files are written in the byte order of the machine and are not meant to be shared between machines.
+         * Files are written on a thread of the cache, so storing a response never waits for the disk.
+         * If the directory can't be created, only the memory is used
+         *
+         * @param directory: Directory that the responses will be written to, responses already in it are used as well
+         * @param maxBytes: Maximum total size of the files, the least recently used ones are removed above it
+         */
+        HttpCache& setDiskDirectory(const std::string& directory, const size_t maxBytes = 256 * 1024 * 1024) noexcept
+        {
+            std::lock_guard<std::mutex> lock(diskMutex);
+
+            diskOrder.clear();
+            diskIndex.clear();
+            diskBytes = 0;
+            diskDirectory.clear();
+            maxDiskBytes = maxBytes;
+
+            std::error_code error;
+
+            std::filesystem::create_directories(directory, error);
+
+            if (!std::filesystem::is_directory(directory, error) || !startWriter())
+            {
+                return *this;
+            }
+
+            std::vector<std::tuple<std::filesystem::file_time_type, std::string, size_t>> files;
+
+            for (const auto& file : std::filesystem::directory_iterator(directory, error))
+            {
+                if (file.is_regular_file(error) && file.path().extension() == ".cache")
+                {
+                    files.emplace_back(file.last_write_time(error), file.path().filename().string(), static_cast<size_t>(file.file_size(error)));
+                }
+            }
+
+            // The most recently written files are the most recently used ones
+            std::sort(files.begin(), files.end(), [](const auto& left, const auto& right)
+            {
+                return std::get<0>(left) > std::get<0>(right);
+            });
+
+            diskDirectory = directory;
+
+            for (const auto& file : files)
+            {
+                diskOrder.push_back(std::get<1>(file));
+                diskIndex[std::get<1>(file)] = {std::prev(diskOrder.end()), std::get<2>(file)};
+                diskBytes += std::get<2>(file);
+            }
+
+            trimDisk();
+
+            return *this;
+        }
+
+        /**
+         * @brief Remove the stored response of the given URL from the memory and the disk
+         *
+         * @param url: URL of the request, including its query string
+         */
+        void remove(const std::string& url) noexcept
+        {
+            {
+                auto& shard = shardFor(url);
+
+                std::lock_guard<std::mutex> lock(shard.mutex);
+
+                const auto it = shard.index.find(url);
+
+                if (it != shard.index.end())
+                {
+                    shard.bytes -= (*it->second)->size();
+                    shard.order.erase(it->second);
+                    shard.index.erase(it);
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(writeMutex);
+
+                pendingWrites.erase(url);
+                writeGeneration++;
+            }
+
+            std::lock_guard<std::mutex> lock(diskMutex);
+
+            removeFile(fileName(url));
+        }
+
+        /**
+         * @brief Remove all stored responses from the memory and the disk
+         */
+        void clear() noexcept
+        {
+            for (auto& shard : shards)
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+
+                shard.order.clear();
+                shard.index.clear();
+                shard.bytes = 0;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(writeMutex);
+
+                pendingWrites.clear();
+                writeQueue.clear();
+                writeGeneration++;
+            }
+
+            std::lock_guard<std::mutex> lock(diskMutex);
+
+            while (!diskOrder.empty())
+            {
+                removeFile(diskOrder.back());
+            }
+        }
+
+        /**
+         * @brief Wait until the responses stored so far are written to the disk
+         */
+        void flush() noexcept
+        {
+            std::unique_lock<std::mutex> lock(writeMutex);
+
+            writeFinished.wait(lock, [this]
+            {
+                return pendingWrites.empty() && !writing;
+            });
+        }
+
+        /**
+         * @brief Get the statistics of the cache
+         *
+         * @return Counters and the number of responses kept in the memory and on the disk
+         */
+        [[nodiscard]] HttpCacheStatistics statistics() const noexcept
+        {
+            HttpCacheStatistics stats;
+
+            stats.hits = hits;
+            stats.staleHits = staleHits;
+            stats.misses = misses;
+            stats.revalidations = revalidations;
+            stats.stores = stores;
+            stats.evictions = evictions;
+
+            for (const auto& shard : shards)
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+
+                stats.memoryEntries += shard.index.size();
+                stats.memoryBytes += shard.bytes;
+            }
+
+            std::lock_guard<std::mutex> lock(diskMutex);
+
+            stats.diskEntries = diskIndex.size();
+            stats.diskBytes = diskBytes;
+
+            return stats;
+        }
+
+    private:
+        friend class HttpRequest;
+
+        using Directives = std::map<std::string, std::string>;
+        using HeaderLookup = std::function<std::string(std::string_view name)>;
+
+        /**
+         * @brief Stored response, never modified after it is created so it can be used without a lock
+         */
+        struct Entry
+        {
+            std::string url;
+            int statusCode = 0;
+            std::string headers;
+            SharedBuffer body;
+            std::vector<std::pair<std::string, std::string>> vary; /* Lower case request header names and their values */
+            long long responseTime = 0; /* Seconds since epoch when the response is received */
+            long long initialAge = 0;
+            long long freshnessLifetime = 0;
+            long long staleWhileRevalidate = 0;
+            bool noCache = false;
+            bool mustRevalidate = false;
+            std::string etag;
+            std::string lastModified;
+
+            [[nodiscard]] size_t size() const noexcept
+            {
+                size_t total = sizeof(Entry) + url.size() + headers.size() + body.size();
+
+                for (const auto& header : vary)
+                {
+                    total += header.first.size() + header.second.size();
+                }
+
+                return total;
+            }
+        };
+
+        enum class Freshness
+        {
+            FRESH,
+            STALE_WHILE_REVALIDATE, /* Stale, but can be served while it is revalidated in the background */
+            STALE
+        };
+
+        struct Shard
+        {
+            mutable std::mutex mutex;
+            std::list<std::shared_ptr<const Entry>> order; /* Most recently used first */
+            std::unordered_map<std::string, std::list<std::shared_ptr<const Entry>>::iterator> index;
+            size_t bytes = 0;
+        };
+
+        /**
+         * @brief Layout of the beginning of a cache file, followed by the URL, headers, vary block and body
+         */
+        struct DiskHeader
+        {
+            char magic[4];
+            std::int32_t statusCode;
+            std::int64_t responseTime;
+            std::int64_t initialAge;
+            std::int64_t freshnessLifetime;
+            std::int64_t staleWhileRevalidate;
+            std::uint32_t flags;
+            std::uint32_t urlLength;
+            std::uint32_t headersLength;
+            std::uint32_t varyLength;
+            std::uint64_t bodyLength;
+        };
+
+        static constexpr char DiskMagic[4] = {'L', 'K', 'C', '1'};
+        static constexpr std::uint32_t NoCacheFlag = 1;
+        static constexpr std::uint32_t MustRevalidateFlag = 2;
+
+        std::vector<Shard> shards;
+        const size_t maxShardBytes;
+        mutable std::mutex diskMutex;
+        std::string diskDirectory;
+        size_t maxDiskBytes = 0;
+        size_t diskBytes = 0;
+        std::list<std::string> diskOrder; /* File names, most recently used first */
+        std::unordered_map<std::string, std::pair<std::list<std::string>::iterator, size_t>> diskIndex;
+        std::mutex writeMutex;
+        std::condition_variable writeAvailable;
+        std::condition_variable writeFinished;
+        std::deque<std::string> writeQueue; /* URLs in the order they are stored */
+        std::unordered_map<std::string, std::shared_ptr<const Entry>> pendingWrites; /* Latest entry of each URL in the queue */
+        std::shared_ptr<const Entry> writing;
+        size_t writingGeneration = 0;
+        std::atomic<size_t> writeGeneration{0}; /* Changed by remove and clear, so the files being written are dropped */
+        std::thread writer;
+        bool stopping = false;
+        std::mutex revalidationMutex;
+        std::unordered_set<std::string> revalidating;
+        std::atomic<size_t> hits{0};
+        std::atomic<size_t> staleHits{0};
+        std::atomic<size_t> misses{0};
+        std::atomic<size_t> revalidations{0};
+        std::atomic<size_t> stores{0};
+        std::atomic<size_t> evictions{0};
+
+        Shard& shardFor(const std::string& url) noexcept
+        {
+            return shards[std::hash<std::string>{}(url) % shards.size()];
+        }
+
+        /**
+         * @brief Find the stored response of the URL that matches the request headers listed in its Vary header
+         */
+        std::shared_ptr<const Entry> find(const std::string& url, const HeaderLookup& requestHeader)
+        {
+            std::shared_ptr<const Entry> entry;
+
+            {
+                auto& shard = shardFor(url);
+
+                std::lock_guard<std::mutex> lock(shard.mutex);
+
+                const auto it = shard.index.find(url);
+
+                if (it != shard.index.end())
+                {
+                    shard.order.splice(shard.order.begin(), shard.order, it->second);
+
+                    entry = *it->second;
+                }
+            }
+
+            if (!entry)
+            {
+                entry = pendingWrite(url);
+            }
+
+            if (!entry)
+            {
+                entry = readFile(url);
+
+                if (!entry)
+                {
+                    return nullptr;
+                }
+
+                keepInMemory(entry);
+            }
+
+            for (const auto& header : entry->vary)
+            {
+                if (requestHeader(header.first) != header.second)
+                {
+                    return nullptr;
+                }
+            }
+
+            return entry;
+        }
+
+        /**
+         * @brief Store the response if it is allowed to and useful to
+         *
+         * @return Stored entry, nullptr if the response is not stored
+         */
+        std::shared_ptr<const Entry> store(const std::string& url, const int statusCode, const HttpHeaders& headers, SharedBuffer body, const HeaderLookup& requestHeader, const long long now)
+        {
+            static constexpr int cacheableStatusCodes[] = {200, 203, 204, 300, 301, 308, 404, 405, 410, 414, 501};
+
+            if (std::find(std::begin(cacheableStatusCodes), std::end(cacheableStatusCodes), statusCode) == std::end(cacheableStatusCodes))
+            {
+                return nullptr;
+            }
+
+            const auto directives = parseDirectives(joinValues(headers, "Cache-Control"));
+
+            if (directives.count("no-store"))
+            {
+                return nullptr;
+            }
+
+            auto entry = std::make_shared<Entry>();
+
+            entry->url = url;
+            entry->statusCode = statusCode;
+            entry->headers = headers.raw();
+            entry->body = std::move(body);
+
+            std::istringstream varyNames(joinValues(headers, "Vary"));
+            std::string name;
+
+            while (std::getline(varyNames, name, ','))
+            {
+                name = toLower(trim(name));
+
+                if (name == "*")
+                {
+                    return nullptr;
+                }
+
+                if (!name.empty())
+                {
+                    entry->vary.emplace_back(name, requestHeader(name));
+                }
+            }
+
+            if (!fillFromHeaders(*entry, headers, directives, now))
+            {
+                return nullptr;
+            }
+
+            keepInMemory(entry);
+            queueWrite(entry);
+
+            stores++;
+
+            return entry;
+        }
+
+        /**
+         * @brief Create the entry that replaces a stored one after the server confirms it with "304 Not Modified"
+         * Headers of the 304 response replace the stored ones with the same name
+         */
+        std::shared_ptr<const Entry> refresh(const Entry& stored, const HttpHeaders& notModifiedHeaders, const long long now)
+        {
+            const HttpHeaders storedHeaders(stored.headers);
+
+            std::string merged;
+
+            const auto statusLineEnd = stored.headers.find('\n');
+
+            if (stored.headers.compare(0, 5, "HTTP/") == 0 && statusLineEnd != std::string::npos)
+            {
+                merged = stored.headers.substr(0, statusLineEnd + 1);
+            }
+
+            const auto replaced = [&notModifiedHeaders](const std::string_view name)
+            {
+                return !HttpHeaders::equalsIgnoreCase(name, "Content-Length") && notModifiedHeaders.contains(name);
+            };
+
+            for (const auto& header : storedHeaders.entries())
+            {
+                if (!replaced(header.first))
+                {
+                    merged.append(header.first).append(": ").append(header.second).append("\r\n");
+                }
+            }
+
+            for (const auto& header : notModifiedHeaders.entries())
+            {
+                if (replaced(header.first))
+                {
+                    merged.append(header.first).append(": ").append(header.second).append("\r\n");
+                }
+            }
+
+            merged.append("\r\n");
+
+            auto entry = std::make_shared<Entry>();
+
+            entry->url = stored.url;
+            entry->statusCode = stored.statusCode;
+            entry->headers = std::move(merged);
+            entry->body = stored.body;
+            entry->vary = stored.vary;
+
+            const HttpHeaders headers(entry->headers);
+
+            if (!fillFromHeaders(*entry, headers, parseDirectives(joinValues(headers, "Cache-Control")), now))
+            {
+                return nullptr;
+            }
+
+            keepInMemory(entry);
+            queueWrite(entry);
+
+            revalidations++;
+
+            return entry;
+        }
+
+        /**
+         * @brief Calculate the freshness lifetime and age of the response, returns false if it is not worth storing
+         */
+        static bool fillFromHeaders(Entry& entry, const HttpHeaders& headers, const Directives& directives, const long long now)
+        {
+            const auto date = parseDate(headers.get("Date"));
+            const auto dateValue = date < 0 ? now : date;
+
+            // RFC 9111, 4.2.3. The response delay is not known, so it is left out of the corrected age
+            const auto ageValue = std::max<long long>(parseSeconds(headers.get("Age")), 0);
+
+            entry.responseTime = now;
+            entry.initialAge = std::max(std::max<long long>(now - dateValue, 0), ageValue);
+            entry.noCache = directives.count("no-cache") > 0;
+            entry.mustRevalidate = directives.count("must-revalidate") > 0;
+            entry.staleWhileRevalidate = std::max<long long>(directiveSeconds(directives, "stale-while-revalidate"), 0);
+            entry.etag = std::string(headers.get("ETag"));
+            entry.lastModified = std::string(headers.get("Last-Modified"));
+
+            const auto maxAge = directiveSeconds(directives, "max-age");
+            const auto expires = headers.contains("Expires") ? parseDate(headers.get("Expires")) : -1;
+            const auto lastModified = parseDate(entry.lastModified);
+
+            if (maxAge >= 0)
+            {
+                entry.freshnessLifetime = maxAge;
+            }
+            else if (headers.contains("Expires"))
+            {
+                // Invalid dates like "0" mean the response is already expired
+                entry.freshnessLifetime = std::max<long long>(expires - dateValue, 0);
+            }
+            else if (lastModified >= 0 && !directives.count("no-cache"))
+            {
+                // Heuristic freshness (RFC 9111, 4.2.2), 10% of the time since the last modification, at most a day
+                entry.freshnessLifetime = std::min<long long>(std::max<long long>(dateValue - lastModified, 0) / 10, 24 * 60 * 60);
+            }
+
+            const auto hasValidator = !entry.etag.empty() || !entry.lastModified.empty();
+
+            return hasValidator || (!entry.noCache && entry.freshnessLifetime > entry.initialAge);
+        }
+
+        static Freshness freshness(const Entry& entry, const Directives& requestDirectives, const long long now) noexcept
+        {
+            if (entry.noCache || requestDirectives.count("no-cache"))
+            {
+                return Freshness::STALE;
+            }
+
+            const auto age = entry.initialAge + std::max<long long>(now - entry.responseTime, 0);
+
+            auto lifetime = entry.freshnessLifetime;
+
+            const auto maxAge = directiveSeconds(requestDirectives, "max-age");
+
+            if (maxAge >= 0)
+            {
+                lifetime = std::min(lifetime, maxAge);
+            }
+
+            if (age < lifetime)
+            {
+                return Freshness::FRESH;
+            }
+
+            if (!entry.mustRevalidate && age < entry.freshnessLifetime + entry.staleWhileRevalidate)
+            {
+                return Freshness::STALE_WHILE_REVALIDATE;
+            }
+
+            return Freshness::STALE;
+        }
+
+        /**
+         * @brief Mark the URL as being revalidated, returns false if it is already being revalidated
+         */
+        bool beginRevalidation(const std::string& url)
+        {
+            std::lock_guard<std::mutex> lock(revalidationMutex);
+
+            return revalidating.insert(url).second;
+        }
+
+        void endRevalidation(const std::string& url)
+        {
+            std::lock_guard<std::mutex> lock(revalidationMutex);
+
+            revalidating.erase(url);
+        }
+
+        void keepInMemory(const std::shared_ptr<const Entry>& entry)
+        {
+            auto& shard = shardFor(entry->url);
+
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            const auto existing = shard.index.find(entry->url);
+
+            if (existing != shard.index.end())
+            {
+                shard.bytes -= (*existing->second)->size();
+                shard.order.erase(existing->second);
+                shard.index.erase(existing);
+            }
+
+            const auto size = entry->size();
+
+            // Responses larger than a shard are only kept on the disk
+            if (size > maxShardBytes)
+            {
+                return;
+            }
+
+            shard.order.push_front(entry);
+            shard.index[entry->url] = shard.order.begin();
+            shard.bytes += size;
+
+            while (shard.bytes > maxShardBytes)
+            {
+                const auto& last = shard.order.back();
+
+                shard.bytes -= last->size();
+                shard.index.erase(last->url);
+                shard.order.pop_back();
+
+                evictions++;
+            }
+        }
+
+        static std::string fileName(const std::string& url)
+        {
+            // FNV-1a, the URL is kept in the file as well, so collisions are detected when it is read
+            std::uint64_t hash = 14695981039346656037ULL;
+
+            for (const auto c : url)
+            {
+                hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+            }
+
+            char name[24];
+
+            std::snprintf(name, sizeof(name), "%016llx.cache", static_cast<unsigned long long>(hash));
+
+            return name;
+        }
+
+        /**
+         * @brief Start the thread that writes the files, returns false if it can't be started
+         */
+        bool startWriter() noexcept
+        {
+            std::lock_guard<std::mutex> lock(writeMutex);
+
+            if (writer.joinable())
+            {
+                return true;
+            }
+
+            try
+            {
+                writer = std::thread([this]
+                {
+                    writeFiles();
+                });
+            }
+            catch (const std::system_error&)
+            {
+                return false;
+            }
+
+            return true;
+        }
+
+        /**
+         * @brief Hand the entry to the writer thread, a newer entry of the same URL replaces one that is not written yet
+         */
+        void queueWrite(const std::shared_ptr<const Entry>& entry)
+        {
+            {
+                std::lock_guard<std::mutex> lock(writeMutex);
+
+                if (!writer.joinable())
+                {
+                    return;
+                }
+
+                const auto inserted = pendingWrites.insert_or_assign(entry->url, entry).second;
+
+                if (inserted)
+                {
+                    writeQueue.push_back(entry->url);
+                }
+            }
+
+            writeAvailable.notify_one();
+        }
+
+        /**
+         * @brief Entry of the URL that is not written to the disk yet, so responses only kept on the disk are found meanwhile
+         */
+        std::shared_ptr<const Entry> pendingWrite(const std::string& url)
+        {
+            std::lock_guard<std::mutex> lock(writeMutex);
+
+            const auto it = pendingWrites.find(url);
+
+            if (it != pendingWrites.end())
+            {
+                return it->second;
+            }
+
+            if (writing && writing->url == url && writingGeneration == writeGeneration)
+            {
+                return writing;
+            }
+
+            return nullptr;
+        }
+
+        /**
+         * @brief Write the queued entries until the cache is destroyed, the entries still in the queue are written before it stops
+         */
+        void writeFiles() noexcept
+        {
+            while (true)
+            {
+                size_t generation = 0;
+
+                {
+                    std::unique_lock<std::mutex> lock(writeMutex);
+
+                    writing.reset();
+
+                    writeFinished.notify_all();
+
+                    writeAvailable.wait(lock, [this]
+                    {
+                        return stopping || !writeQueue.empty();
+                    });
+
+                    if (writeQueue.empty())
+                    {
+                        return;
+                    }
+
+                    const auto it = pendingWrites.find(writeQueue.front());
+
+                    writeQueue.pop_front();
+
+                    // Removed after it is queued
+                    if (it == pendingWrites.end())
+                    {
+                        continue;
+                    }
+
+                    writing = std::move(it->second);
+                    generation = writeGeneration;
+                    writingGeneration = generation;
+
+                    pendingWrites.erase(it);
+                }
+
+                try
+                {
+                    writeFile(*writing, generation);
+                }
+                catch (...)
+                {
+                    // A response that can't be written is only kept in the memory
+                }
+            }
+        }
+
+        /**
+         * @brief Write the entry to its file, only the index is updated with diskMutex held
+         */
+        void writeFile(const Entry& entry, const size_t generation)
+        {
+            std::string directory;
+            size_t maxBytes = 0;
+
+            {
+                std::lock_guard<std::mutex> lock(diskMutex);
+
+                directory = diskDirectory;
+                maxBytes = maxDiskBytes;
+            }
+
+            if (directory.empty())
+            {
+                return;
+            }
+
+            std::string varyBlock;
+
+            for (const auto& header : entry.vary)
+            {
+                varyBlock.append(header.first).append("\n").append(header.second).append("\n");
+            }
+
+            DiskHeader header{};
+
+            std::memcpy(header.magic, DiskMagic, sizeof(DiskMagic));
+            header.statusCode = entry.statusCode;
+            header.responseTime = entry.responseTime;
+            header.initialAge = entry.initialAge;
+            header.freshnessLifetime = entry.freshnessLifetime;
+            header.staleWhileRevalidate = entry.staleWhileRevalidate;
+            header.flags = (entry.noCache ? NoCacheFlag : 0) | (entry.mustRevalidate ? MustRevalidateFlag : 0);
+            header.urlLength = static_cast<std::uint32_t>(entry.url.size());
+            header.headersLength = static_cast<std::uint32_t>(entry.headers.size());
+            header.varyLength = static_cast<std::uint32_t>(varyBlock.size());
+            header.bodyLength = entry.body.size();
+
+            const auto size = sizeof(header) + entry.url.size() + entry.headers.size() + varyBlock.size() + entry.body.size();
+            const auto name = fileName(entry.url);
+
+            if (size > maxBytes)
+            {
+                std::lock_guard<std::mutex> lock(diskMutex);
+
+                // The file of an older response of the URL is out of date
+                if (diskDirectory == directory)
+                {
+                    removeFile(name);
+                }
+
+                return;
+            }
+
+            // The file is written under a temporary name and renamed, so a reader never sees a partially written one
+            const auto path = directory + "/" + name;
+            const auto temporaryPath = path + ".tmp";
+
+            auto* file = std::fopen(temporaryPath.c_str(), "wb");
+
+            if (!file)
+            {
+                return;
+            }
+
+            auto written = std::fwrite(&header, sizeof(header), 1, file) == 1
+                && std::fwrite(entry.url.data(), 1, entry.url.size(), file) == entry.url.size()
+                && std::fwrite(entry.headers.data(), 1, entry.headers.size(), file) == entry.headers.size()
+                && std::fwrite(varyBlock.data(), 1, varyBlock.size(), file) == varyBlock.size();
+
+            for (const auto chunk : entry.body.chunks())
+            {
+                written = written && std::fwrite(chunk.data(), 1, chunk.size(), file) == chunk.size();
+            }
+
+            if (std::fclose(file) != 0 || !written)
+            {
+                std::remove(temporaryPath.c_str());
+
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(diskMutex);
+
+            // The directory is changed or the response is removed while the file is written
+            if (diskDirectory != directory || generation != writeGeneration)
+            {
+                std::remove(temporaryPath.c_str());
+
+                return;
+            }
+
+            removeFile(name);
+
+            std::error_code error;
+
+            std::filesystem::rename(temporaryPath, path, error);
+
+            if (error)
+            {
+                std::remove(temporaryPath.c_str());
+
+                return;
+            }
+
+            diskOrder.push_front(name);
+            diskIndex[name] = {diskOrder.begin(), size};
+            diskBytes += size;
+
+            trimDisk();
+        }
+
+        std::shared_ptr<const Entry> readFile(const std::string& url)
+        {
+            std::lock_guard<std::mutex> lock(diskMutex);
+
+            const auto name = fileName(url);
+            const auto indexed = diskIndex.find(name);
+
+            if (diskDirectory.empty() || indexed == diskIndex.end())
+            {
+                return nullptr;
+            }
+
+            std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen((diskDirectory + "/" + name).c_str(), "rb"), &std::fclose);
+
+            DiskHeader header{};
+
+            if (!file || std::fread(&header, sizeof(header), 1, file.get()) != 1 || std::memcmp(header.magic, DiskMagic, sizeof(DiskMagic)) != 0
+                || sizeof(header) + header.urlLength + header.headersLength + header.varyLength + header.bodyLength != indexed->second.second)
+            {
+                file.reset();
+
+                removeFile(name);
+
+                return nullptr;
+            }
+
+            const auto read = [&file](std::string& target, const size_t length)
+            {
+                target.resize(length);
+
+                return std::fread(target.data(), 1, length, file.get()) == length;
+            };
+
+            auto entry = std::make_shared<Entry>();
+
+            std::string varyBlock;
+            std::string body;
+
+            if (!read(entry->url, header.urlLength) || entry->url != url)
+            {
+                // Another URL with the same file name
+                return nullptr;
+            }
+
+            if (!read(entry->headers, header.headersLength) || !read(varyBlock, header.varyLength) || !read(body, header.bodyLength))
+            {
+                file.reset();
+
+                removeFile(name);
+
+                return nullptr;
+            }
+
+            std::istringstream varyLines(varyBlock);
+            std::string varyName;
+            std::string varyValue;
+
+            while (std::getline(varyLines, varyName) && std::getline(varyLines, varyValue))
+            {
+                entry->vary.emplace_back(std::move(varyName), std::move(varyValue));
+            }
+
+            const HttpHeaders headers(entry->headers);
+
+            entry->statusCode = header.statusCode;
+            entry->body = SharedBuffer(std::move(body));
+            entry->responseTime = header.responseTime;
+            entry->initialAge = header.initialAge;
+            entry->freshnessLifetime = header.freshnessLifetime;
+            entry->staleWhileRevalidate = header.staleWhileRevalidate;
+            entry->noCache = (header.flags & NoCacheFlag) != 0;
+            entry->mustRevalidate = (header.flags & MustRevalidateFlag) != 0;
+            entry->etag = std::string(headers.get("ETag"));
+            entry->lastModified = std::string(headers.get("Last-Modified"));
+
+            diskOrder.splice(diskOrder.begin(), diskOrder, indexed->second.first);
+
+            return entry;
+        }
+
+        /**
+         * @brief Remove the file from the disk and the index, must be called with diskMutex held
+         */
+        void removeFile(const std::string& name)
+        {
+            const auto it = diskIndex.find(name);
+
+            if (it == diskIndex.end())
+            {
+                return;
+            }
+
+            std::remove((diskDirectory + "/" + name).c_str());
+
+            diskBytes -= it->second.second;
+            diskOrder.erase(it->second.first);
+            diskIndex.erase(it);
+        }
+
+        /**
+         * @brief Remove the least recently used files until the total size is within the limit, must be called with diskMutex held
+         */
+        void trimDisk()
+        {
+            while (diskBytes > maxDiskBytes && !diskOrder.empty())
+            {
+                removeFile(diskOrder.back());
+            }
+        }
+
+        static std::string joinValues(const HttpHeaders& headers, const std::string_view name)
+        {
+            std::string joined;
+
+            for (const auto value : headers.getAll(name))
+            {
+                if (!joined.empty())
+                {
+                    joined += ",";
+                }
+
+                joined += value;
+            }
+
+            return joined;
+        }
+
+        /**
+         * @brief Parse a Cache-Control header into lower case directive names and their unquoted values
+         */
+        static Directives parseDirectives(const std::string& value)
+        {
+            Directives directives;
+
+            std::istringstream stream(value);
+            std::string directive;
+
+            while (std::getline(stream, directive, ','))
+            {
+                const auto equals = directive.find('=');
+
+                auto name = toLower(trim(directive.substr(0, equals)));
+
+                if (name.empty())
+                {
+                    continue;
+                }
+
+                auto argument = equals == std::string::npos ? std::string() : trim(directive.substr(equals + 1));
+
+                if (argument.size() >= 2 && argument.front() == '"' && argument.back() == '"')
+                {
+                    argument = argument.substr(1, argument.size() - 2);
+                }
+
+                directives.emplace(std::move(name), std::move(argument));
+            }
+
+            return directives;
+        }
+
+        /**
+         * @brief Value of a directive in seconds, -1 if it is not present or invalid
+         */
+        static long long directiveSeconds(const Directives& directives, const std::string& name) noexcept
+        {
+            const auto it = directives.find(name);
+
+            return it == directives.end() ? -1 : parseSeconds(it->second);
+        }
+
+        static long long parseSeconds(const std::string_view value) noexcept
+        {
+            if (value.empty() || value.size() > 18 || !std::all_of(value.begin(), value.end(), [](const unsigned char c) { return std::isdigit(c); }))
+            {
+                return -1;
+            }
+
+            return std::stoll(std::string(value));
+        }
+
+        static long long parseDate(const std::string_view value)
+        {
+            if (value.empty())
+            {
+                return -1;
+            }
+
+            return static_cast<long long>(curl_getdate(std::string(value).c_str(), nullptr));
+        }
+
+        static std::string trim(const std::string& value)
+        {
+            const auto first = value.find_first_not_of(" \t");
+
+            if (first == std::string::npos)
+            {
+                return {};
+            }
+
+            return value.substr(first, value.find_last_not_of(" \t") - first + 1);
+        }
+
+        static std::string toLower(std::string value)
+        {
+            std::transform(value.begin(), value.end(), value.begin(), [](const unsigned char c)
+            {
+                return static_cast<char>(std::tolower(c));
+            });
+
+            return value;
+        }
+    };
+
+    /**
+     * @brief Makes identical GET requests that are in progress at the same time share a single transfer
+     * Requests are identical if their method, URL and the values of the key headers are the same. The first
+     * request is sent, the others wait for it and every caller receives a copy of its result. The body is returned
+     * in HttpResult::sharedData, so it is kept only once however many callers there are
+     */
+    class RequestCoalescer
+    {
+    public:
+        /**
+         * @brief Constructor for the RequestCoalescer class
+         *
+         * @param keyHeaders: Request headers whose values must be the same for the requests to be coalesced
+         */
+        explicit RequestCoalescer(std::vector<std::string> keyHeaders = {"Authorization", "Cookie", "Accept", "Accept-Encoding", "Accept-Language"})
+            : keyHeaders(std::move(keyHeaders))
+        {
+        }
+
+        RequestCoalescer(const RequestCoalescer&) = delete;
+
+        RequestCoalescer& operator=(const RequestCoalescer&) = delete;
+
+        /**
+         * @brief Get the number of transfers in progress
+         */
+        [[nodiscard]] size_t inFlight() const noexcept
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            return flights.size();
+        }
+
+        /**
+         * @brief Get the number of requests that received the result of another request instead of being sent
+         */
+        [[nodiscard]] size_t coalescedCount() const noexcept
+        {
+            return coalesced;
+        }
+
+    private:
+        friend class HttpRequest;
+        friend class HttpClient;
+
+        const std::vector<std::string> keyHeaders;
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, std::vector<std::function<void(HttpResult&&)>>> flights;
+        std::atomic<size_t> coalesced{0};
+
+        /**
+         * @brief Wait for the transfer of the key, returns true if there is none and the caller must send the request
+         */
+        bool join(const std::string& key, std::function<void(HttpResult&&)> onComplete)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto& waiters = flights[key];
+
+            waiters.push_back(std::move(onComplete));
+
+            if (waiters.size() == 1)
+            {
+                return true;
+            }
+
+            coalesced++;
+
+            return false;
+        }
+
+        /**
+         * @brief Complete all requests waiting for the transfer of the key with its result
+         */
+        void finish(const std::string& key, HttpResult&& result)
+        {
+            std::vector<std::function<void(HttpResult&&)>> waiters;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                const auto it = flights.find(key);
+
+                if (it == flights.end())
+                {
+                    return;
+                }
+
+                waiters = std::move(it->second);
+
+                flights.erase(it);
+            }
+
+            // The request that is sent returns its body as a shared buffer, this only converts a body that isn't
+            if (result.sharedData.empty())
+            {
+                if (!result.textData.empty())
+                {
+                    result.sharedData = SharedBuffer(std::move(result.textData));
+                }
+                else if (!result.binaryData.empty())
+                {
+                    result.sharedData = SharedBuffer(std::string(result.binaryData.begin(), result.binaryData.end()));
+                }
+
+                // Cleared buffers keep their capacity and are returned to the pool when the result is destroyed
+                result.textData.clear();
+                result.binaryData.clear();
+            }
+
+            for (size_t i = 1; i < waiters.size(); i++)
+            {
+                HttpResult copy = result;
+
+                copy.bufferPool.reset();
+                copy.coalesced = true;
+
+                waiters[i](std::move(copy));
+            }
+
+            waiters.front()(std::move(result));
+        }
+    };
+
+    /**
+     * @brief HTTP request class that makes asynchronous HTTP calls
+     */
+    class HttpRequest
+    {
+    public:
+        /**
+         * @brief Constructor for the HttpRequest class
+         *
+         * @param url: URL for the request
+         */
+        explicit HttpRequest(const std::string& url)
+        {
+            this->url = url;
+
+            CurlGlobalInitializer::initialize();
+
+            this->connectionPool = ConnectionPool::shared();
+        }
+
+        /**
+         * @brief Set the HTTP method for the request
+         *
+         * @param method: HTTP method to be used for the request
+         */
+        HttpRequest& setMethod(const HttpMethod& method) noexcept
+        {
+            this->method = HttpMethodStrings[static_cast<int>(method)];
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the query string for the request
+         *
+         * @param queryString: Query string to be sent with the request
+         */
+        HttpRequest& setQueryString(const std::string& queryString) noexcept
+        {
+            if (this->url.find('?') != std::string::npos)
+            {
+                this->url += "&" + queryString;
+            }
+            else
+            {
+                this->url += "?" + queryString;
+            }
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the payload for the request
+         * You can send form data like param1=7&param2=test or JSON data like {"param1": 7, "param2": "test"}
+         * You need to send the "Content-Type" as "application/json" in the HTTP Header, if you need to send json data in the payload
+         *
+         * @param payload: Payload to be sent with the request
+         */
+        HttpRequest& setPayload(const std::string& payload) noexcept
+        {
+            this->payload = payload;
+            this->payloadReader = nullptr;
+            this->payloadFilePath.clear();
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the payload for the request by moving it into the request instead of copying
+         *
+         * @param payload: Payload to be sent with the request
+         */
+        HttpRequest& setPayload(std::string&& payload) noexcept
+        {
+            this->payload = std::move(payload);
+            this->payloadReader = nullptr;
+            this->payloadFilePath.clear();
+
+            return *this;
+        }
+
+        /**
+         * @brief Set a callback that the payload will be read from piece by piece while it is being sent
+         * The payload is never held in memory as a whole, so it can be larger than the available memory.
+         * The callback must fill the buffer with at most bufferSize bytes and return the number of bytes
+         * written, 0 when there is no more data
+         *
+         * @param reader: Callback that provides the payload
+         * @param payloadSize: Size of the payload in bytes (-1 if unknown, then it is sent chunked)
+         */
+        HttpRequest& setPayloadStream(std::function<size_t(char* buffer, size_t bufferSize)> reader, const long long payloadSize = -1) noexcept
+        {
+            this->payload.clear();
+            this->payloadReader = std::move(reader);
+            this->payloadSize = payloadSize;
+            this->payloadFilePath.clear();
+
+            return *this;
+        }
+
+        /**
+         * @brief Set a stream that the payload will be read from while it is being sent
+         * The stream must be kept alive until the result is received
+         *
+         * @param stream: Stream that provides the payload
+         * @param payloadSize: Size of the payload in bytes (-1 if unknown, then it is sent chunked)
+         */
+        HttpRequest& setPayloadStream(std::istream& stream, const long long payloadSize = -1) noexcept
+        {
+            return setPayloadStream([&stream](char* buffer, const size_t bufferSize) -> size_t
+            {
+                if (!stream)
+                {
+                    return 0;
+                }
+
+                stream.read(buffer, static_cast<std::streamsize>(bufferSize));
+
+                return static_cast<size_t>(stream.gcount());
+            }, payloadSize);
+        }
+
+        /**
+         * @brief Set a file descriptor (file, pipe, socket etc.) that the payload will be read from while it is being sent
+         * The file descriptor is not closed by the request and must be kept open until the result is received
+         *
+         * @param fileDescriptor: File descriptor that provides the payload
+         * @param payloadSize: Size of the payload in bytes (-1 if unknown, then it is sent chunked)
+         */
+        HttpRequest& setPayloadStream(const int fileDescriptor, const long long payloadSize = -1) noexcept
+        {
+            return setPayloadStream([fileDescriptor](char* buffer, const size_t bufferSize) -> size_t
+            {
+#ifdef _WIN32
+                const auto bytesRead = _read(fileDescriptor, buffer, static_cast<unsigned int>(bufferSize));
+#else
+                const auto bytesRead = read(fileDescriptor, buffer, bufferSize);
+#endif
+
+                return bytesRead > 0 ? static_cast<size_t>(bytesRead) : 0;
+            }, payloadSize);
+        }
+
+        /**
+         * @brief Set a file whose content will be sent as the payload
+         * The file is memory mapped and sent directly from the mapping, so it is neither loaded into
+         * memory as a whole nor copied (on Windows, it is read piece by piece instead)
+         *
+         * @param path: Path of the file to be sent
+         */
+        HttpRequest& setPayloadFromFile(const std::string& path) noexcept
+        {
+            this->payload.clear();
+            this->payloadReader = nullptr;
+            this->payloadFilePath = path;
+
+            return *this;
+        }
+
+        /**
+         * @brief Write the response body directly into a file instead of textData/binaryData
+         * The number of bytes written is returned in bytesWritten of the result. If the request fails,
+         * the file is removed
+         *
+         * @param path: Path of the file to be written (overwritten if it exists)
+         * @param syncPolicy: Whether the file is flushed to the disk before the result is returned
+         */
+        HttpRequest& downloadToFile(const std::string& path, const FileSyncPolicy syncPolicy = FileSyncPolicy::NONE) noexcept
+        {
+            this->downloadFilePath = path;
+            this->downloadSyncPolicy = syncPolicy;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the return format for the request as binary
+         */
+        HttpRequest& returnAsBinary() noexcept
+        {
+            this->returnFormat = ReturnFormat::BINARY;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the return format for the request as a shared immutable buffer (see HttpResult::sharedData)
+         * The body is kept in the chunks it is received in and is never copied to a bigger buffer, and the result
+         * can be passed to several consumers or stored in an HttpCache without copying the body
+         */
+        HttpRequest& returnAsShared() noexcept
+        {
+            this->returnFormat = ReturnFormat::SHARED;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the buffer that the response body will be written into directly
+         * The body is neither copied into textData/binaryData nor reallocated while it is being received.
+         * If the body is larger than the buffer, the request fails. The buffer must be kept alive
+         * until the result is received
+         *
+         * @param buffer: Destination of the response body
+         * @param size: Size of the buffer in bytes
+         */
+        HttpRequest& setResponseBuffer(void* buffer, const size_t size) noexcept
+        {
+            this->responseBuffer = static_cast<unsigned char*>(buffer);
+            this->responseBufferSize = size;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the pool that the response buffers will be taken from
+         * The buffers are returned to the pool when the HttpResult is destroyed
+         *
+         * @param pool: Response buffer pool to be used (nullptr allocates new buffers for every response)
+         */
+        HttpRequest& setResponseBufferPool(std::shared_ptr<ResponseBufferPool> pool) noexcept
+        {
+            this->responseBufferPool = std::move(pool);
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the metrics registry that the counters and latency of the request will be recorded to
+         *
+         * @param metrics: Metrics registry to be used (nullptr disables recording)
+         */
+        HttpRequest& setMetrics(std::shared_ptr<HttpMetrics> metrics) noexcept
+        {
+            this->metrics = std::move(metrics);
+
+            return *this;
+        }
+
+        /**
+         * @brief Add a HTTP header to the request
+         *
+         * @param key: Header key
+         * @param value: Header value
+         */
+        HttpRequest& addHeader(const std::string& key, const std::string& value) noexcept
+        {
+            this->headers[key] = value;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the timeout for the request
+         *
+         * @param timeout: Timeout in seconds (0 for no timeout)
+         */
+        HttpRequest& setTimeout(const int timeout) noexcept
+        {
+            this->timeout = std::chrono::seconds(timeout);
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the timeout for the request with millisecond precision
+         *
+         * @param timeout: Timeout of the whole request (0 for no timeout)
+         */
+        HttpRequest& setTimeout(const std::chrono::milliseconds timeout) noexcept
+        {
+            this->timeout = timeout;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the timeout for establishing the connection, separately from the timeout of the whole request
+         *
+         * @param timeout: Connect timeout in seconds (0 for the default of 300 seconds)
+         */
+        HttpRequest& setConnectTimeout(const int timeout) noexcept
+        {
+            this->connectTimeout = std::chrono::seconds(timeout);
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the timeout for establishing the connection with millisecond precision
+         *
+         * @param timeout: Connect timeout (0 for the default of 300 seconds)
+         */
+        HttpRequest& setConnectTimeout(const std::chrono::milliseconds timeout) noexcept
+        {
+            this->connectTimeout = timeout;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the point in time that the request must be completed by
+         * The remaining time is applied as the timeout when the transfer starts, so time spent waiting in a
+         * queue counts against it. The request fails without being sent if the deadline has already passed
+         *
+         * @param deadline: Deadline of the request
+         */
+        HttpRequest& setDeadline(const std::chrono::steady_clock::time_point deadline) noexcept
+        {
+            this->deadline = deadline;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the token that can cancel the request while it is waiting or in progress
+         *
+         * @param token: Cancellation token (see CancellationToken)
+         */
+        HttpRequest& setCancellationToken(CancellationToken token) noexcept
+        {
+            this->cancellationToken = std::move(token);
+
+            return *this;
+        }
+
+        /**
+         * @brief Send duplicates of the request after a delay if it is slow, the first successful response wins
+         * Only suitable for idempotent requests. Hedged requests are sent on an HttpClient, send() uses HttpClient::shared().
+         * Requests with a payload stream, a download file or their own response buffer are sent only once
+         *
+         * @param policy: Hedging settings (see HedgingPolicy)
+         */
+        HttpRequest& setHedging(HedgingPolicy policy) noexcept
+        {
+            this->hedgingPolicy = std::move(policy);
+
+            return *this;
+        }
+
+        /**
+         * @brief Retry the request automatically if it fails with a transient error
+         * Retries reuse the connection of the failed attempt if it is still open. Requests with a payload stream are sent only once
+         *
+         * @param policy: Retry settings (see RetryPolicy)
+         */
+        HttpRequest& setRetryPolicy(RetryPolicy policy) noexcept
+        {
+            this->retryPolicy = std::move(policy);
+
+            return *this;
+        }
+
+        /**
+         * @brief Ignore SSL errors when making HTTP requests
+         */
+        HttpRequest& ignoreSslErrors() noexcept
+        {
+            this->sslErrorsWillBeIgnored = true;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the cache that the response of the request is served from and stored in
+         * Only GET requests without a payload are cached, and not if the response is written to a file, a buffer
+         * set by setResponseBuffer or streamed with onDataReceived. Fresh responses are returned at once without
+         * contacting the server, stale ones are revalidated with a conditional request
+         *
+         * @param cache: Cache to be used (nullptr disables caching)
+         */
+        HttpRequest& setCache(std::shared_ptr<HttpCache> cache) noexcept
+        {
+            this->cache = std::move(cache);
+
+            return *this;
+        }
+
+        /**
+         * @brief Make the request share the transfer of an identical GET request that is already in progress
+         * Only GET requests without a payload, a cancellation token or a deadline are coalesced, and not if the response
+         * is written to a file, a buffer set by setResponseBuffer or streamed with onDataReceived. Coalesced requests are
+         * sent on the process-wide HttpClient and their body is returned in HttpResult::sharedData
+         *
+         * @param coalescer: Coalescer that keeps track of the requests in progress (nullptr disables coalescing)
+         */
+        HttpRequest& setCoalescer(std::shared_ptr<RequestCoalescer> coalescer) noexcept
+        {
+            this->coalescer = std::move(coalescer);
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the TLS version for the request
+         *
+         * @param version: TLS version to be used for the request
+         */
+        HttpRequest& setTLSVersion(const TLSVersion version) noexcept
+        {
+            this->tlsVersion = version;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the HTTP version for the request
+         *
+         * @param version: HTTP version to be used for the request
+         */
+        HttpRequest& setHttpVersion(const HttpVersion version) noexcept
+        {
+            this->httpVersion = version;
+
+            return *this;
+        }
+
+        /**
+         * @brief Collect the timing breakdown (DNS, connect, TLS, TTFB, total), transferred bytes,
+         * connection reuse and HTTP version of the request into the timings field of the result
+         */
+        HttpRequest& collectTimings() noexcept
+        {
+            this->timingsEnabled = true;
+
+            return *this;
+        }
+
+        /**
+         * @brief Ask the server to compress the response. It is decompressed piece by piece while it is being received,
+         * so the result and the data passed to the stream callback are always decompressed
+         *
+         * @param encodings: Comma separated list of encodings like "gzip, br" (empty for all the encodings libcurl is built with among gzip, deflate, br and zstd)
+         */
+        HttpRequest& acceptCompression(const std::string& encodings = "") noexcept
+        {
+            this->acceptEncoding = encodings;
+
+            return *this;
+        }
+
+        /**
+         * @brief Compress the payload before it is sent and set the "Content-Encoding" header accordingly
+         * Payload streams and files are compressed piece by piece while they are being sent, so they are sent chunked.
+         * The codec must be enabled with LIBCPP_HTTP_CLIENT_WITH_ZLIB or LIBCPP_HTTP_CLIENT_WITH_ZSTD, otherwise the request fails
+         *
+         * @param codec: Compression codec
+         * @param level: Compression level (0 for the default level of the codec, 1 - 9 for gzip, 1 - 22 for zstd)
+         */
+        HttpRequest& compressPayload(const CompressionCodec codec, const int level = 0) noexcept
+        {
+            this->payloadCodec = codec;
+            this->payloadCompressionLevel = level;
+
+            return *this;
+        }
+
+#ifdef LIBCPP_HTTP_CLIENT_WITH_ZSTD
+        /**
+         * @brief Compress the payload with zstd using a pre-trained dictionary before it is sent
+         *
+         * @param dictionary: Dictionary to be used, its compression level is used as well
+         */
+        HttpRequest& compressPayload(std::shared_ptr<ZstdDictionary> dictionary) noexcept
+        {
+            this->payloadCodec = CompressionCodec::ZSTD;
+            this->zstdDictionary = std::move(dictionary);
+
+            return *this;
+        }
+#endif
+
+        /**
+         * @brief Set the user agent for the request
+         *
+         * @param userAgent: User agent to be used for the request
+         */
+        HttpRequest& setUserAgent(const std::string& userAgent) noexcept
+        {
+            this->userAgent = userAgent;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the download bandwidth limit for the request
+         *
+         * @param limit: Download bandwidth limit in bytes per second (0 for no limit)
+         */
+        HttpRequest& setDownloadBandwidthLimit(const int limit) noexcept
+        {
+            this->downloadBandwidthLimit = limit;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the upload bandwidth limit for the request
+         *
+         * @param limit: Upload bandwidth limit in bytes per second (0 for no limit)
+         */
+        HttpRequest& setUploadBandwidthLimit(const int limit) noexcept
+        {
+            this->uploadBandwidthLimit = limit;
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the connection pool to be used for the request
+         * By default, all requests share the process-wide pool returned by ConnectionPool::shared()
+         *
+         * @param pool: Connection pool to be used (nullptr opens a new connection for every request)
+         */
+        HttpRequest& setConnectionPool(std::shared_ptr<ConnectionPool> pool) noexcept
+        {
+            this->connectionPool = std::move(pool);
+
+            return *this;
+        }
+
+        /**
+         * @brief The callback that will be triggered when each piece (chunk) of incoming data is processed
          *
          * @param callback: Callback function that will be called with the data and its length
         */
         HttpRequest& onDataReceived(std::function<void(const unsigned char* data, size_t dataLength)> callback) noexcept
         {
-            dataCallback = std::move(callback);
+            dataCallback = std::move(callback);
+
+            return *this;
+        }
+
+        /**
+         * @brief Convert the request to a cURL command string
+         * This can be useful for debugging or logging purposes
+         *
+         * @return cURL command string representing the request
+         */
+        [[nodiscard]] std::string toCurlCommand() const noexcept
+        {
+            std::ostringstream cmd;
+
+            cmd << "curl";
+
+            cmd << " -X " << method;
+
+            for (const auto& header : headers)
+            {
+                cmd << " -H \"" << header.first << ": " << header.second << "\"";
+            }
+
+            if (!userAgent.empty())
+            {
+                cmd << " -A \"" << userAgent << "\"";
+            }
+
+            if (acceptEncoding)
+            {
+                cmd << " --compressed";
+
+                if (!acceptEncoding->empty())
+                {
+                    cmd << " -H \"Accept-Encoding: " << *acceptEncoding << "\"";
+                }
+            }
+
+            if (timeout.count() > 0)
+            {
+                cmd << " --max-time " << formatSeconds(timeout);
+            }
+
+            if (connectTimeout.count() > 0)
+            {
+                cmd << " --connect-timeout " << formatSeconds(connectTimeout);
+            }
+
+            if (sslErrorsWillBeIgnored)
+            {
+                cmd << " -k";
+            }
+
+            if (downloadBandwidthLimit > 0)
+            {
+                cmd << " --limit-rate " << downloadBandwidthLimit;
+            }
+
+            if (connectionPool)
+            {
+                for (const auto& entry : connectionPool->resolveOverrideEntries())
+                {
+                    cmd << " --resolve '" << escapeSingleQuotes(entry) << "'";
+                }
+            }
+
+            switch (httpVersion)
+            {
+            case HttpVersion::HTTP_1_0:
+                cmd << " --http1.0";
+                break;
+            case HttpVersion::HTTP_1_1:
+                cmd << " --http1.1";
+                break;
+            case HttpVersion::HTTP_2:
+                cmd << " --http2";
+                break;
+            case HttpVersion::HTTP_2_PRIOR_KNOWLEDGE:
+                cmd << " --http2-prior-knowledge";
+                break;
+            default:
+                break;
+            }
+
+            if (!payloadFilePath.empty())
+            {
+                cmd << " --data-binary '@" << escapeSingleQuotes(payloadFilePath) << "'";
+            }
+            else if (payloadReader)
+            {
+                cmd << " --data-binary @-";
+            }
+            else if (!payload.empty())
+            {
+                cmd << " --data '" << escapeSingleQuotes(payload) << "'";
+            }
+
+            if (!downloadFilePath.empty())
+            {
+                cmd << " -o '" << escapeSingleQuotes(downloadFilePath) << "'";
+            }
+
+            cmd << " \"" << url << "\"";
+
+            return cmd.str();
+        }
+
+        /**
+         * @brief Send the HTTP request and return the result as a future
+         * The result can be obtained by calling the get() method of the future
+         * get() method will block until the result is available so it is recommended to use it
+         * when you need the result and no more other http requests will be made as parallel
+         *
+         * @return Result of the request as a future (see HttpResult object for details)
+         */
+        std::future<HttpResult> send() noexcept
+        {
+            if (auto cached = this->cachedResult())
+            {
+                return readyResult(std::move(*cached));
+            }
+
+            if (this->hedgingPolicy || this->isCoalesced())
+            {
+                return this->sendOnSharedClient();
+            }
+
+            return this->sendRequest();
+        }
+
+        /**
+         * @brief Send the HTTP request on the given executor and return the result as a future
+         * Unlike send(), no new thread is started for the request. The request object must be kept
+         * alive until the result is received
+         *
+         * @param executor: Executor that runs the request (see ThreadPoolExecutor)
+         *
+         * @return Result of the request as a future (see HttpResult object for details)
+         */
+        std::future<HttpResult> send(Executor& executor) noexcept
+        {
+            if (auto cached = this->cachedResult())
+            {
+                return readyResult(std::move(*cached));
+            }
+
+            if (this->hedgingPolicy || this->isCoalesced())
+            {
+                return this->sendOnSharedClient();
+            }
+
+            auto promise = std::make_shared<std::promise<HttpResult>>();
+
+            auto future = promise->get_future();
+
+            const auto accepted = executor.execute([this, promise]
+            {
+                promise->set_value(this->perform());
+            });
+
+            if (!accepted)
+            {
+                promise->set_value({false, "", {}, 0, "Request is rejected by the executor"});
+            }
+
+            return future;
+        }
+
+        /**
+         * @brief Send the HTTP request on the process-wide HttpClient and call the given function with the result
+         * No future is created, the function is called directly on the event loop thread of the client, so it
+         * should return quickly. The request is copied, so the HttpRequest object does not need to outlive the call
+         *
+         * @param onComplete: Function to be called with the result (see HttpResult object for details)
+         */
+        void send(std::function<void(HttpResult&&)> onComplete) const noexcept;
+
+    private:
+        friend class HttpClient;
+
+        enum class ReturnFormat
+        {
+            TEXT,
+            BINARY,
+            SHARED
+        };
+
+        const char* HttpMethodStrings[5] = {
+            "GET",
+            "POST",
+            "PUT",
+            "DELETE",
+            "PATCH"
+        };
+
+        std::string url;
+        std::string method = "GET";
+        std::string payload;
+        std::string userAgent;
+        bool sslErrorsWillBeIgnored = false;
+        ReturnFormat returnFormat = ReturnFormat::TEXT;
+        std::map<std::string, std::string> headers;
+        std::chrono::milliseconds timeout{0};
+        std::chrono::milliseconds connectTimeout{0};
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+        std::optional<CancellationToken> cancellationToken;
+        std::optional<HedgingPolicy> hedgingPolicy;
+        std::optional<RetryPolicy> retryPolicy;
+        std::shared_ptr<HttpCache> cache;
+        bool backgroundRevalidation = false;
+        std::shared_ptr<RequestCoalescer> coalescer;
+        int uploadBandwidthLimit = 0;
+        int downloadBandwidthLimit = 0;
+        TLSVersion tlsVersion = TLSVersion::DEFAULT;
+        HttpVersion httpVersion = HttpVersion::DEFAULT;
+        bool timingsEnabled = false;
+        std::optional<std::string> acceptEncoding;
+        std::optional<CompressionCodec> payloadCodec;
+        int payloadCompressionLevel = 0;
+#ifdef LIBCPP_HTTP_CLIENT_WITH_ZSTD
+        std::shared_ptr<ZstdDictionary> zstdDictionary;
+#endif
+        std::shared_ptr<HttpMetrics> metrics;
+        std::shared_ptr<ConnectionPool> connectionPool;
+        unsigned char* responseBuffer = nullptr;
+        size_t responseBufferSize = 0;
+        std::shared_ptr<ResponseBufferPool> responseBufferPool;
+        std::function<size_t(char* buffer, size_t bufferSize)> payloadReader;
+        long long payloadSize = -1;
+        std::string payloadFilePath;
+        std::string downloadFilePath;
+        FileSyncPolicy downloadSyncPolicy = FileSyncPolicy::NONE;
+
+        /**
+         * @brief Read-only view of a whole file, memory mapped where it is supported
+         */
+        class PayloadFile
+        {
+        public:
+            PayloadFile() = default;
+
+            ~PayloadFile()
+            {
+#ifndef _WIN32
+                if (mapping)
+                {
+                    munmap(mapping, size);
+                }
+#endif
+            }
+
+            PayloadFile(const PayloadFile&) = delete;
+
+            PayloadFile& operator=(const PayloadFile&) = delete;
+
+            bool open(const std::string& path) noexcept
+            {
+#ifdef _WIN32
+                stream.open(path, std::ios::binary | std::ios::ate);
+
+                if (!stream)
+                {
+                    return false;
+                }
+
+                size = static_cast<size_t>(stream.tellg());
+
+                stream.seekg(0);
+
+                return true;
+#else
+                const int fd = ::open(path.c_str(), O_RDONLY);
+
+                if (fd < 0)
+                {
+                    return false;
+                }
+
+                struct stat info{};
+
+                if (fstat(fd, &info) != 0)
+                {
+                    ::close(fd);
+
+                    return false;
+                }
+
+                size = static_cast<size_t>(info.st_size);
+
+                if (size > 0)
+                {
+                    void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+                    if (address == MAP_FAILED)
+                    {
+                        ::close(fd);
+
+                        return false;
+                    }
+
+                    mapping = address;
+
+                    madvise(mapping, size, MADV_SEQUENTIAL);
+                }
+
+                // The mapping remains valid after the file descriptor is closed
+                ::close(fd);
+
+                return true;
+#endif
+            }
+
+            [[nodiscard]] const char* data() const noexcept
+            {
+                return mapping ? static_cast<const char*>(mapping) : "";
+            }
+
+            [[nodiscard]] size_t length() const noexcept
+            {
+                return size;
+            }
+
+            [[nodiscard]] bool isMapped() const noexcept
+            {
+#ifdef _WIN32
+                return false;
+#else
+                return true;
+#endif
+            }
+
+            size_t read(char* buffer, const size_t bufferSize) noexcept
+            {
+                stream.read(buffer, static_cast<std::streamsize>(bufferSize));
+
+                return static_cast<size_t>(stream.gcount());
+            }
+
+        private:
+            void* mapping = nullptr;
+            size_t size = 0;
+            std::ifstream stream;
+        };
+
+        /**
+         * @brief Compresses the payload in one go or piece by piece
+         */
+        class PayloadEncoder
+        {
+        public:
+            virtual ~PayloadEncoder() = default;
+
+            /**
+             * @brief Compress the given data and append the compressed data to the output
+             *
+             * @param data: Data to be compressed
+             * @param size: Size of the data
+             * @param finish: Whether it is the last piece of the payload
+             * @param output: Compressed data is appended to it
+             *
+             * @return false if the data could not be compressed
+             */
+            virtual bool encode(const char* data, size_t size, bool finish, std::string& output) = 0;
+        };
+
+#ifdef LIBCPP_HTTP_CLIENT_WITH_ZLIB
+        class GzipEncoder : public PayloadEncoder
+        {
+        public:
+            explicit GzipEncoder(const int level)
+            {
+                // 16 is added to the window bits to write a gzip header instead of a zlib one
+                initialized = deflateInit2(&stream, level == 0 ? Z_DEFAULT_COMPRESSION : level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+            }
+
+            ~GzipEncoder() override
+            {
+                if (initialized)
+                {
+                    deflateEnd(&stream);
+                }
+            }
+
+            GzipEncoder(const GzipEncoder&) = delete;
+
+            GzipEncoder& operator=(const GzipEncoder&) = delete;
+
+            explicit operator bool() const noexcept
+            {
+                return initialized;
+            }
+
+            bool encode(const char* data, size_t size, const bool finish, std::string& output) override
+            {
+                constexpr size_t chunkSize = 16384;
+
+                int result = Z_OK;
+
+                do
+                {
+                    // avail_in is 32 bits, so large payloads are passed in pieces
+                    const auto piece = std::min<size_t>(size, size_t(1) << 30);
+
+                    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+                    stream.avail_in = static_cast<uInt>(piece);
+
+                    data += piece;
+                    size -= piece;
+
+                    const int flush = finish && size == 0 ? Z_FINISH : Z_NO_FLUSH;
+
+                    do
+                    {
+                        const auto offset = output.size();
+
+                        output.resize(offset + chunkSize);
+
+                        stream.next_out = reinterpret_cast<Bytef*>(&output[offset]);
+                        stream.avail_out = static_cast<uInt>(chunkSize);
+
+                        result = deflate(&stream, flush);
+
+                        output.resize(offset + chunkSize - stream.avail_out);
+
+                        if (result == Z_STREAM_ERROR)
+                        {
+                            return false;
+                        }
+                    }
+                    while (stream.avail_out == 0);
+                }
+                while (size > 0);
+
+                return !finish || result == Z_STREAM_END;
+            }
+
+        private:
+            z_stream stream{};
+            bool initialized = false;
+        };
+#endif
+
+#ifdef LIBCPP_HTTP_CLIENT_WITH_ZSTD
+        class ZstdEncoder : public PayloadEncoder
+        {
+        public:
+            ZstdEncoder(const int level, const ZstdDictionary* dictionary) : context(ZSTD_createCCtx())
+            {
+                if (!context)
+                {
+                    return;
+                }
+
+                // Compression level of the dictionary is used if there is one
+                const auto result = dictionary ? ZSTD_CCtx_refCDict(context, dictionary->dictionary) : ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, level);
+
+                if (ZSTD_isError(result))
+                {
+                    ZSTD_freeCCtx(context);
+
+                    context = nullptr;
+                }
+            }
+
+            ~ZstdEncoder() override
+            {
+                ZSTD_freeCCtx(context);
+            }
+
+            ZstdEncoder(const ZstdEncoder&) = delete;
+
+            ZstdEncoder& operator=(const ZstdEncoder&) = delete;
+
+            explicit operator bool() const noexcept
+            {
+                return context != nullptr;
+            }
+
+            bool encode(const char* data, const size_t size, const bool finish, std::string& output) override
+            {
+                ZSTD_inBuffer input{data, size, 0};
+
+                const auto chunkSize = ZSTD_CStreamOutSize();
+
+                while (true)
+                {
+                    const auto offset = output.size();
+
+                    output.resize(offset + chunkSize);
+
+                    ZSTD_outBuffer out{&output[offset], chunkSize, 0};
+
+                    const auto remaining = ZSTD_compressStream2(context, &out, &input, finish ? ZSTD_e_end : ZSTD_e_continue);
+
+                    output.resize(offset + out.pos);
+
+                    if (ZSTD_isError(remaining))
+                    {
+                        return false;
+                    }
+
+                    // The frame is complete when nothing remains to be flushed, otherwise it is enough to consume the input
+                    if (finish ? remaining == 0 : input.pos == input.size)
+                    {
+                        return true;
+                    }
+                }
+            }
+
+        private:
+            ZSTD_CCtx* context = nullptr;
+        };
+#endif
+
+        struct FileCloser
+        {
+            void operator()(std::FILE* file) const
+            {
+                if (file)
+                {
+                    std::fclose(file);
+                }
+            }
+        };
+
+        class CurlHandle
+        {
+        public:
+            CurlHandle(std::shared_ptr<ConnectionPool> pool, const std::string& url)
+                : pool(std::move(pool)), hostKey(this->pool ? getHostKey(url) : std::string())
+            {
+                handle = this->pool ? this->pool->acquire(hostKey) : curl_easy_init();
+            }
+
+            ~CurlHandle()
+            {
+                if (!handle)
+                {
+                    return;
+                }
+
+                if (pool)
+                {
+                    pool->release(hostKey, handle);
+                }
+                else
+                {
+                    curl_easy_cleanup(handle);
+                }
+            }
+
+            CurlHandle(const CurlHandle&) = delete;
+
+            CurlHandle& operator=(const CurlHandle&) = delete;
+
+            [[nodiscard]] CURL* get() const noexcept
+            {
+                return handle;
+            }
+
+            explicit operator bool() const noexcept
+            {
+                return handle != nullptr;
+            }
+
+        private:
+            std::shared_ptr<ConnectionPool> pool;
+            std::string hostKey;
+            CURL* handle = nullptr;
+        };
+
+        struct CurlSlistDeleter
+        {
+            void operator()(curl_slist* ptr) const
+            {
+                if (ptr)
+                {
+                    curl_slist_free_all(ptr);
+                }
+            }
+        };
+
+        std::function<void(const unsigned char* data, size_t dataLength)> dataCallback;
+
+        /**
+         * @brief State of a single transfer that must live until the transfer is completed
+         */
+        struct TransferContext
+        {
+            const HttpRequest* request = nullptr;
+            CURL* handle = nullptr;
+            std::unique_ptr<curl_slist, CurlSlistDeleter> headerList;
+            std::unique_ptr<curl_slist, CurlSlistDeleter> resolveList;
+            std::string stringBuffer;
+            std::vector<unsigned char> binaryBuffer;
+            std::vector<std::string> sharedChunks;
+            size_t sharedBytes = 0;
+            std::string headerBuffer;
+            size_t bytesWritten = 0;
+            size_t bytesStreamed = 0;
+            bool bodyStarted = false;
+            std::string errorMessage;
+            std::unique_ptr<PayloadFile> payloadFile;
+            std::unique_ptr<std::FILE, FileCloser> downloadFile;
+            std::unique_ptr<PayloadEncoder> payloadEncoder;
+            std::string encodedPayload;
+            size_t encodedPayloadOffset = 0;
+            bool payloadEncoded = false;
+            std::shared_ptr<const HttpCache::Entry> cacheEntry;
+        };
+
+        std::future<HttpResult> sendRequest() noexcept
+        {
+            return std::async(std::launch::async, [this]() -> HttpResult
+            {
+                return this->perform();
+            });
+        }
+
+        /**
+         * @brief Send the request on the process-wide HttpClient, which handles hedging and coalescing
+         */
+        std::future<HttpResult> sendOnSharedClient() const noexcept;
+
+        /**
+         * @brief Send a copy of the request on the process-wide HttpClient to revalidate its stale cached response
+         */
+        void revalidateInBackground() const noexcept;
+
+        static std::future<HttpResult> readyResult(HttpResult&& result) noexcept
+        {
+            std::promise<HttpResult> promise;
+
+            promise.set_value(std::move(result));
+
+            return promise.get_future();
+        }
+
+        /**
+         * @brief Whether the request is a GET without a payload whose whole response is returned in the result
+         */
+        bool isPlainGet() const noexcept
+        {
+            if (this->method != "GET" || !this->payload.empty() || this->payloadReader || !this->payloadFilePath.empty())
+            {
+                return false;
+            }
+
+            return this->downloadFilePath.empty() && !this->responseBuffer && !this->dataCallback;
+        }
+
+        bool isCacheable() const noexcept
+        {
+            if (!this->cache || !this->isPlainGet())
+            {
+                return false;
+            }
+
+            return HttpCache::parseDirectives(this->requestCacheControl()).count("no-store") == 0;
+        }
+
+        bool isCoalesced() const noexcept
+        {
+            // A cancellation token or a deadline belongs to a single caller, so it can't be shared by the others
+            return this->coalescer && this->isPlainGet() && !this->cancellationToken && !this->deadline;
+        }
+
+        /**
+         * @brief Method, URL and the values of the key headers of the coalescer
+         */
+        std::string coalescingKey() const
+        {
+            std::string key = this->method + " " + this->url;
+
+            for (const auto& name : this->coalescer->keyHeaders)
+            {
+                key.append("\n").append(HttpCache::toLower(name)).append(": ").append(this->requestHeader(name));
+            }
+
+            return key;
+        }
+
+        /**
+         * @brief Value of a request header as it will be sent, empty if it is not set
+         */
+        std::string requestHeader(const std::string_view name) const
+        {
+            for (const auto& header : this->headers)
+            {
+                if (HttpHeaders::equalsIgnoreCase(header.first, name))
+                {
+                    return header.second;
+                }
+            }
+
+            if (HttpHeaders::equalsIgnoreCase(name, "User-Agent"))
+            {
+                return this->userAgent;
+            }
+
+            return {};
+        }
+
+        std::string requestCacheControl() const
+        {
+            auto cacheControl = this->requestHeader("Cache-Control");
+
+            // "Pragma: no-cache" is only used if there is no Cache-Control header (RFC 9111, 5.4)
+            if (cacheControl.empty() && HttpCache::toLower(this->requestHeader("Pragma")).find("no-cache") != std::string::npos)
+            {
+                cacheControl = "no-cache";
+            }
+
+            return cacheControl;
+        }
+
+        /**
+         * @brief Result served from the cache without contacting the server, nothing if the request must be sent
+         */
+        std::optional<HttpResult> cachedResult() const noexcept
+        {
+            if (this->backgroundRevalidation || !this->isCacheable())
+            {
+                return std::nullopt;
+            }
+
+            const auto entry = this->cache->find(this->url, [this](const std::string_view name)
+            {
+                return this->requestHeader(name);
+            });
+
+            const auto freshness = entry
+                                       ? HttpCache::freshness(*entry, HttpCache::parseDirectives(this->requestCacheControl()), std::time(nullptr))
+                                       : HttpCache::Freshness::STALE;
+
+            if (freshness == HttpCache::Freshness::FRESH)
+            {
+                this->cache->hits++;
+
+                return this->cachedResult(*entry, CacheStatus::HIT);
+            }
+
+            if (freshness == HttpCache::Freshness::STALE_WHILE_REVALIDATE)
+            {
+                if (this->cache->beginRevalidation(this->url))
+                {
+                    this->revalidateInBackground();
+                }
+
+                this->cache->staleHits++;
+
+                return this->cachedResult(*entry, CacheStatus::STALE);
+            }
+
+            this->cache->misses++;
+
+            return std::nullopt;
+        }
+
+        HttpResult cachedResult(const HttpCache::Entry& entry, const CacheStatus status) const
+        {
+            const auto succeed = entry.statusCode >= 200 && entry.statusCode < 300;
+
+            HttpResult result;
+
+            result.succeed = succeed;
+            result.statusCode = entry.statusCode;
+            result.errorMessage = succeed ? "" : "HTTP Error: " + std::to_string(entry.statusCode);
+            result.headers = HttpHeaders(entry.headers);
+            result.decodedBytes = static_cast<long long>(entry.body.size());
+            result.cacheStatus = status;
+
+            if (this->returnFormat == ReturnFormat::SHARED)
+            {
+                result.sharedData = entry.body;
+            }
+            else if (this->returnFormat == ReturnFormat::BINARY)
+            {
+                result.binaryData = entry.body.toBinary();
+            }
+            else
+            {
+                result.textData = entry.body.toString();
+            }
+
+            return result;
+        }
+
+        /**
+         * @brief Store the response in the cache, or replace it with the stored one if the server returned "304 Not Modified"
+         */
+        void updateCache(TransferContext& context, HttpResult& result) const
+        {
+            if (!this->isCacheable())
+            {
+                // A successful unsafe request invalidates the stored response of its URL (RFC 9111, 4.4)
+                if (this->cache && this->method != "GET" && result.curlCode == CURLE_OK && result.statusCode >= 200 && result.statusCode < 400)
+                {
+                    this->cache->remove(this->url);
+                }
+
+                return;
+            }
+
+            result.cacheStatus = CacheStatus::MISS;
+
+            if (result.curlCode != CURLE_OK)
+            {
+                return;
+            }
+
+            const auto now = std::time(nullptr);
+
+            if (result.statusCode == 304 && context.cacheEntry)
+            {
+                const auto entry = this->cache->refresh(*context.cacheEntry, result.headers, now);
+
+                auto revalidated = this->cachedResult(entry ? *entry : *context.cacheEntry, CacheStatus::REVALIDATED);
+
+                revalidated.wireBytes = result.wireBytes;
+                revalidated.timings = result.timings;
+                revalidated.attempt = result.attempt;
+
+                result = std::move(revalidated);
+
+                return;
+            }
+
+            // A shared body is stored without copying it
+            auto body = result.sharedData;
+
+            if (this->returnFormat == ReturnFormat::BINARY)
+            {
+                body = SharedBuffer(std::string(result.binaryData.begin(), result.binaryData.end()));
+            }
+            else if (this->returnFormat == ReturnFormat::TEXT)
+            {
+                body = SharedBuffer(result.textData);
+            }
+
+            this->cache->store(this->url, result.statusCode, result.headers, std::move(body), [this](const std::string_view name)
+            {
+                return this->requestHeader(name);
+            }, now);
+        }
+
+        HttpResult perform() const noexcept
+        {
+            CurlHandle curl(this->connectionPool, this->url);
+
+            if (!curl)
+            {
+                return {false, "", {}, 0, "CURL initialization failed"};
+            }
+
+            if (this->retryPolicy)
+            {
+                this->retryPolicy->requestStarted();
+            }
+
+            for (int attempt = 0;; attempt++)
+            {
+                // Options of the previous attempt point to its context, the connections are kept by the reset
+                if (attempt > 0)
+                {
+                    curl_easy_reset(curl.get());
+                }
+
+                auto result = this->performOnce(curl.get());
+
+                result.attempt = attempt;
+
+                const auto delay = this->retryDelay(result, attempt);
+
+                if (!delay)
+                {
+                    return result;
+                }
+
+                if (!this->waitForRetry(*delay))
+                {
+                    HttpResult cancelled(false, "", {}, 0, "Request is cancelled");
+
+                    cancelled.attempt = attempt;
+
+                    return cancelled;
+                }
+            }
+        }
+
+        HttpResult performOnce(CURL* handle) const noexcept
+        {
+            TransferContext context;
+
+            if (!this->prepare(handle, context))
+            {
+                return {false, "", {}, 0, std::move(context.errorMessage)};
+            }
+
+            if (this->metrics)
+            {
+                this->metrics->transferStarted();
+            }
+
+            const auto res = curl_easy_perform(handle);
+
+            return this->complete(context, res);
+        }
+
+        /**
+         * @brief Returns the delay before the request is sent again, nothing if the result must be returned as it is
+         */
+        std::optional<std::chrono::milliseconds> retryDelay(const HttpResult& result, const int attempt) const noexcept
+        {
+            // A payload stream can only be read once
+            if (!this->retryPolicy || this->payloadReader)
+            {
+                return std::nullopt;
+            }
+
+            if (this->cancellationToken && this->cancellationToken->isCancelled())
+            {
+                return std::nullopt;
+            }
+
+            return this->retryPolicy->nextDelay(result, attempt, this->isIdempotent(), this->deadline);
+        }
+
+        bool isIdempotent() const noexcept
+        {
+            if (this->method != "POST" && this->method != "PATCH")
+            {
+                return true;
+            }
+
+            return std::any_of(this->headers.begin(), this->headers.end(), [](const auto& header)
+            {
+                return HttpHeaders::equalsIgnoreCase(header.first, "Idempotency-Key");
+            });
+        }
+
+        /**
+         * @brief Wait before the next attempt, returns false if the request is cancelled in the meantime
+         */
+        bool waitForRetry(const std::chrono::milliseconds delay) const
+        {
+            if (!this->cancellationToken)
+            {
+                std::this_thread::sleep_for(delay);
+
+                return true;
+            }
+
+            std::mutex waitMutex;
+            std::condition_variable cancelled;
+            bool isCancelled = false;
+
+            const auto subscription = this->cancellationToken->subscribe([&]
+            {
+                std::lock_guard<std::mutex> lock(waitMutex);
+
+                isCancelled = true;
+
+                cancelled.notify_all();
+            });
+
+            {
+                std::unique_lock<std::mutex> lock(waitMutex);
+
+                cancelled.wait_for(lock, delay, [&isCancelled]
+                {
+                    return isCancelled;
+                });
+            }
+
+            this->cancellationToken->unsubscribe(subscription);
+
+            return !this->cancellationToken->isCancelled();
+        }
+
+        bool prepare(CURL* handle, TransferContext& context) const noexcept
+        {
+            context.request = this;
+            context.handle = handle;
+
+            if (!this->payloadFilePath.empty())
+            {
+                context.payloadFile = std::make_unique<PayloadFile>();
+
+                if (!context.payloadFile->open(this->payloadFilePath))
+                {
+                    context.errorMessage = "Payload file could not be opened: " + this->payloadFilePath;
+
+                    return false;
+                }
+            }
+
+            if (!this->downloadFilePath.empty())
+            {
+                context.downloadFile.reset(std::fopen(this->downloadFilePath.c_str(), "wb"));
+
+                if (!context.downloadFile)
+                {
+                    context.errorMessage = "Download file could not be created: " + this->downloadFilePath;
+
+                    return false;
+                }
+            }
+
+            for (const auto& header : this->headers)
+            {
+                std::string headerStr = header.first + ": " + header.second;
+
+                context.headerList.reset(curl_slist_append(context.headerList.release(), headerStr.c_str()));
+            }
+
+            if (this->isCacheable() && this->requestHeader("If-None-Match").empty() && this->requestHeader("If-Modified-Since").empty())
+            {
+                context.cacheEntry = this->cache->find(this->url, [this](const std::string_view name)
+                {
+                    return this->requestHeader(name);
+                });
+
+                // The stored response is confirmed with a conditional request instead of being downloaded again
+                if (context.cacheEntry && !context.cacheEntry->etag.empty())
+                {
+                    const auto headerStr = "If-None-Match: " + context.cacheEntry->etag;
+
+                    context.headerList.reset(curl_slist_append(context.headerList.release(), headerStr.c_str()));
+                }
+
+                if (context.cacheEntry && !context.cacheEntry->lastModified.empty())
+                {
+                    const auto headerStr = "If-Modified-Since: " + context.cacheEntry->lastModified;
+
+                    context.headerList.reset(curl_slist_append(context.headerList.release(), headerStr.c_str()));
+                }
+            }
+
+            if (this->payloadCodec && (context.payloadFile || this->payloadReader || !this->payload.empty()))
+            {
+                if (!this->preparePayloadEncoder(context))
+                {
+                    return false;
+                }
+
+                const std::string headerStr = std::string("Content-Encoding: ") + (*this->payloadCodec == CompressionCodec::GZIP ? "gzip" : "zstd");
+
+                context.headerList.reset(curl_slist_append(context.headerList.release(), headerStr.c_str()));
+            }
+
+            curl_easy_setopt(handle, CURLOPT_HTTPHEADER, context.headerList.get());
+            curl_easy_setopt(handle, CURLOPT_URL, this->url.c_str());
+            curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, this->method.c_str());
+            curl_easy_setopt(handle, CURLOPT_SSL_VERIFYPEER, this->sslErrorsWillBeIgnored ? 0L : 1L);
+            curl_easy_setopt(handle, CURLOPT_SSL_VERIFYHOST, this->sslErrorsWillBeIgnored ? 0L : 1L);
+            curl_easy_setopt(handle, CURLOPT_SSLVERSION, static_cast<long>(this->tlsVersion));
+            curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, static_cast<long>(this->httpVersion));
+            auto timeout = this->timeout;
+
+            if (this->deadline)
+            {
+                const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(*this->deadline - std::chrono::steady_clock::now());
+
+                if (remaining.count() <= 0)
+                {
+                    context.errorMessage = "Deadline exceeded";
+
+                    return false;
+                }
+
+                if (timeout.count() == 0 || remaining < timeout)
+                {
+                    timeout = remaining;
+                }
+            }
+
+            if (this->cancellationToken)
+            {
+                if (this->cancellationToken->isCancelled())
+                {
+                    context.errorMessage = "Request is cancelled";
+
+                    return false;
+                }
+
+                curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 0L);
+                curl_easy_setopt(handle, CURLOPT_XFERINFOFUNCTION, progressCallback);
+                curl_easy_setopt(handle, CURLOPT_XFERINFODATA, &context);
+            }
+
+            curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS, static_cast<long>(timeout.count()));
+            curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(this->connectTimeout.count()));
+            curl_easy_setopt(handle, CURLOPT_MAX_SEND_SPEED_LARGE, static_cast<curl_off_t>(this->uploadBandwidthLimit));
+            curl_easy_setopt(handle, CURLOPT_MAX_RECV_SPEED_LARGE, static_cast<curl_off_t>(this->downloadBandwidthLimit));
+            curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+
+            if (this->connectionPool)
+            {
+                curl_easy_setopt(handle, CURLOPT_MAXAGE_CONN, static_cast<long>(this->connectionPool->idleTimeout.load()));
+                curl_easy_setopt(handle, CURLOPT_SHARE, this->connectionPool->share);
+                curl_easy_setopt(handle, CURLOPT_DNS_CACHE_TIMEOUT, static_cast<long>(this->connectionPool->dnsCacheTimeout.load()));
+
+                for (const auto& entry : this->connectionPool->takeResolveEntries())
+                {
+                    context.resolveList.reset(curl_slist_append(context.resolveList.release(), entry.c_str()));
+                }
+
+                if (context.resolveList)
+                {
+                    curl_easy_setopt(handle, CURLOPT_RESOLVE, context.resolveList.get());
+                }
+            }
+
+            if (!this->userAgent.empty())
+            {
+                curl_easy_setopt(handle, CURLOPT_USERAGENT, this->userAgent.c_str());
+            }
+
+            if (this->acceptEncoding)
+            {
+                // libcurl decodes the body before it is passed to the write callbacks
+                curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, this->acceptEncoding->c_str());
+            }
+
+            if (context.payloadEncoder && context.payloadEncoded)
+            {
+                curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(context.encodedPayload.size()));
+                curl_easy_setopt(handle, CURLOPT_POSTFIELDS, context.encodedPayload.data());
+            }
+            else if (context.payloadEncoder)
+            {
+                // Size of the compressed payload is not known in advance, so it is sent chunked
+                curl_easy_setopt(handle, CURLOPT_POST, 1L);
+                curl_easy_setopt(handle, CURLOPT_READFUNCTION, encodingReadCallback);
+                curl_easy_setopt(handle, CURLOPT_READDATA, &context);
+                curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(-1));
+            }
+            else if (context.payloadFile && context.payloadFile->isMapped())
+            {
+                // curl doesn't copy the data set by CURLOPT_POSTFIELDS, so it is sent directly from the mapping
+                curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(context.payloadFile->length()));
+                curl_easy_setopt(handle, CURLOPT_POSTFIELDS, context.payloadFile->data());
+            }
+            else if (context.payloadFile)
+            {
+                curl_easy_setopt(handle, CURLOPT_POST, 1L);
+                curl_easy_setopt(handle, CURLOPT_READFUNCTION, fileReadCallback);
+                curl_easy_setopt(handle, CURLOPT_READDATA, &context);
+                curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(context.payloadFile->length()));
+            }
+            else if (this->payloadReader)
+            {
+                curl_easy_setopt(handle, CURLOPT_POST, 1L);
+                curl_easy_setopt(handle, CURLOPT_READFUNCTION, readCallback);
+                curl_easy_setopt(handle, CURLOPT_READDATA, &context);
+                curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(this->payloadSize));
+            }
+            else if (!this->payload.empty())
+            {
+                curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(this->payload.size()));
+                curl_easy_setopt(handle, CURLOPT_POSTFIELDS, this->payload.c_str());
+            }
+
+            curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, headerCallback);
+            curl_easy_setopt(handle, CURLOPT_HEADERDATA, &context);
+
+            if (dataCallback)
+            {
+                curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, streamingWriteCallback);
+                curl_easy_setopt(handle, CURLOPT_WRITEDATA, &context);
+            }
+            else if (context.downloadFile)
+            {
+                curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, fileWriteCallback);
+                curl_easy_setopt(handle, CURLOPT_WRITEDATA, &context);
+            }
+            else if (this->responseBuffer)
+            {
+                curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, bufferWriteCallback);
+                curl_easy_setopt(handle, CURLOPT_WRITEDATA, &context);
+            }
+            else if (this->returnFormat == ReturnFormat::BINARY)
+            {
+                curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, binaryWriteCallback);
+                curl_easy_setopt(handle, CURLOPT_WRITEDATA, &context);
+            }
+            else if (this->returnFormat == ReturnFormat::SHARED)
+            {
+                curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, sharedWriteCallback);
+                curl_easy_setopt(handle, CURLOPT_WRITEDATA, &context);
+            }
+            else
+            {
+                curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, textWriteCallback);
+                curl_easy_setopt(handle, CURLOPT_WRITEDATA, &context);
+            }
+
+            return true;
+        }
+
+        static HttpResult complete(TransferContext& context, const CURLcode res) noexcept
+        {
+            long statusCode = 0;
+
+            curl_easy_getinfo(context.handle, CURLINFO_RESPONSE_CODE, &statusCode);
+
+            bool succeed = res == CURLE_OK && statusCode >= 200 && statusCode < 300;
+
+            if (context.downloadFile && !finishDownloadFile(context, succeed))
+            {
+                succeed = false;
+            }
+
+            std::string err;
+
+            if (!context.errorMessage.empty())
+            {
+                err = std::move(context.errorMessage);
+            }
+            else if (res != CURLE_OK)
+            {
+                err = curl_easy_strerror(res);
+            }
+            else if (!succeed)
+            {
+                err = "HTTP Error: " + std::to_string(statusCode);
+            }
+
+            curl_off_t wireBytes = 0;
+
+            curl_easy_getinfo(context.handle, CURLINFO_SIZE_DOWNLOAD_T, &wireBytes);
+
+            const auto decodedBytes = context.bytesStreamed + context.bytesWritten + context.stringBuffer.size() + context.binaryBuffer.size() + context.sharedBytes;
+
+            HttpResult result(succeed, std::move(context.stringBuffer), std::move(context.binaryBuffer), static_cast<int>(statusCode), std::move(err));
+
+            if (!context.sharedChunks.empty())
+            {
+                result.sharedData = SharedBuffer(std::move(context.sharedChunks));
+            }
+
+            result.bytesWritten = context.bytesWritten;
+            result.wireBytes = static_cast<long long>(wireBytes);
+            result.decodedBytes = static_cast<long long>(decodedBytes);
+            result.headers = HttpHeaders(std::move(context.headerBuffer));
+            result.curlCode = res;
+
+            if (context.request->timingsEnabled)
+            {
+                result.timings = getTimings(context.handle);
+            }
+
+            if (context.request->metrics)
+            {
+                const auto hostKey = getHostKey(context.request->url);
+                const auto schemeEnd = hostKey.find("://");
+
+                context.request->metrics->transferFinished(context.handle, schemeEnd == std::string::npos ? hostKey : hostKey.substr(schemeEnd + 3), context.request->method, statusCode, res);
+            }
+
+            if (context.request->cache)
+            {
+                context.request->updateCache(context, result);
+            }
+
+            result.bufferPool = context.request->responseBufferPool;
+
+            return result;
+        }
+
+        static HttpTimings getTimings(CURL* handle) noexcept
+        {
+            HttpTimings timings;
+
+            curl_off_t nameLookup = 0, connect = 0, tlsHandshake = 0, startTransfer = 0, total = 0, uploaded = 0, downloaded = 0;
+            long newConnections = 0, version = 0;
+            char* primaryIp = nullptr;
+
+            curl_easy_getinfo(handle, CURLINFO_NAMELOOKUP_TIME_T, &nameLookup);
+            curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME_T, &connect);
+            curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME_T, &tlsHandshake);
+            curl_easy_getinfo(handle, CURLINFO_STARTTRANSFER_TIME_T, &startTransfer);
+            curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME_T, &total);
+            curl_easy_getinfo(handle, CURLINFO_SIZE_UPLOAD_T, &uploaded);
+            curl_easy_getinfo(handle, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+            curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &newConnections);
+            curl_easy_getinfo(handle, CURLINFO_HTTP_VERSION, &version);
+            curl_easy_getinfo(handle, CURLINFO_PRIMARY_IP, &primaryIp);
+
+            timings.collected = true;
+            timings.nameLookup = std::chrono::microseconds(nameLookup);
+            timings.connect = std::chrono::microseconds(connect);
+            timings.tlsHandshake = std::chrono::microseconds(tlsHandshake);
+            timings.startTransfer = std::chrono::microseconds(startTransfer);
+            timings.total = std::chrono::microseconds(total);
+            timings.uploadedBytes = uploaded;
+            timings.downloadedBytes = downloaded;
+            // No connection is used at all if the name can't be resolved or the connection is refused
+            timings.connectionReused = newConnections == 0 && primaryIp && primaryIp[0] != '\0';
+
+            switch (version)
+            {
+            case CURL_HTTP_VERSION_1_0:
+                timings.httpVersion = HttpVersion::HTTP_1_0;
+                break;
+            case CURL_HTTP_VERSION_1_1:
+                timings.httpVersion = HttpVersion::HTTP_1_1;
+                break;
+            case CURL_HTTP_VERSION_2_0:
+                timings.httpVersion = HttpVersion::HTTP_2;
+                break;
+            default:
+                timings.httpVersion = HttpVersion::DEFAULT;
+                break;
+            }
+
+            return timings;
+        }
+
+        /**
+         * @brief Flush and close the downloaded file, remove it if the request is failed
+         */
+        static bool finishDownloadFile(TransferContext& context, const bool succeed) noexcept
+        {
+            bool flushed = std::fflush(context.downloadFile.get()) == 0;
+
+            if (flushed && succeed && context.request->downloadSyncPolicy == FileSyncPolicy::ON_COMPLETE)
+            {
+#ifdef _WIN32
+                flushed = _commit(_fileno(context.downloadFile.get())) == 0;
+#else
+                flushed = fsync(fileno(context.downloadFile.get())) == 0;
+#endif
+            }
+
+            context.downloadFile.reset();
+
+            if (!flushed && context.errorMessage.empty())
+            {
+                context.errorMessage = "Download file could not be written: " + context.request->downloadFilePath;
+            }
+
+            if (!succeed || !flushed)
+            {
+                std::remove(context.request->downloadFilePath.c_str());
+            }
+
+            return flushed;
+        }
+
+        static constexpr size_t MaxReservedBodySize = 64 * 1024 * 1024;
+
+        /**
+         * @brief Reserve the whole body at once when the server sends Content-Length, up to MaxReservedBodySize
+         */
+        static size_t getExpectedBodySize(TransferContext& context) noexcept
+        {
+            if (context.bodyStarted)
+            {
+                return 0;
+            }
+
+            context.bodyStarted = true;
+
+            curl_off_t contentLength = -1;
+
+            if (curl_easy_getinfo(context.handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &contentLength) != CURLE_OK || contentLength <= 0)
+            {
+                contentLength = 0;
+            }
+
+            // Content-Length is sent by the server, a huge one must not make the reservation fail, larger bodies grow as they are received
+            contentLength = std::min(contentLength, static_cast<curl_off_t>(MaxReservedBodySize));
+
+            const auto& pool = context.request->responseBufferPool;
+
+            if (pool)
+            {
+                if (context.request->returnFormat == ReturnFormat::BINARY)
+                {
+                    context.binaryBuffer = pool->acquireBinary(static_cast<size_t>(contentLength));
+                }
+                else
+                {
+                    context.stringBuffer = pool->acquireText(static_cast<size_t>(contentLength));
+                }
+            }
+
+            return static_cast<size_t>(contentLength);
+        }
+
+        /**
+         * @brief Create the encoder of the payload, payloads that are in memory are compressed at once
+         */
+        bool preparePayloadEncoder(TransferContext& context) const
+        {
+            switch (*this->payloadCodec)
+            {
+            case CompressionCodec::GZIP:
+            {
+#ifdef LIBCPP_HTTP_CLIENT_WITH_ZLIB
+                auto encoder = std::make_unique<GzipEncoder>(this->payloadCompressionLevel);
+
+                if (*encoder)
+                {
+                    context.payloadEncoder = std::move(encoder);
+                }
+#else
+                context.errorMessage = "gzip payload compression is not enabled (define LIBCPP_HTTP_CLIENT_WITH_ZLIB and link zlib)";
+
+                return false;
+#endif
+                break;
+            }
+            case CompressionCodec::ZSTD:
+            {
+#ifdef LIBCPP_HTTP_CLIENT_WITH_ZSTD
+                auto encoder = std::make_unique<ZstdEncoder>(this->payloadCompressionLevel, this->zstdDictionary.get());
+
+                if (*encoder && (!this->zstdDictionary || this->zstdDictionary->isValid()))
+                {
+                    context.payloadEncoder = std::move(encoder);
+                }
+#else
+                context.errorMessage = "zstd payload compression is not enabled (define LIBCPP_HTTP_CLIENT_WITH_ZSTD and link zstd)";
+
+                return false;
+#endif
+                break;
+            }
+            }
+
+            if (!context.payloadEncoder)
+            {
+                context.errorMessage = "Payload encoder could not be initialized";
+
+                return false;
+            }
+
+            const char* data = nullptr;
+            size_t size = 0;
+
+            if (context.payloadFile && context.payloadFile->isMapped())
+            {
+                data = context.payloadFile->data();
+                size = context.payloadFile->length();
+            }
+            else if (!context.payloadFile && !this->payloadReader)
+            {
+                data = this->payload.data();
+                size = this->payload.size();
+            }
+            else
+            {
+                return true;
+            }
+
+            if (!context.payloadEncoder->encode(data, size, true, context.encodedPayload))
+            {
+                context.errorMessage = "Payload could not be compressed";
+
+                return false;
+            }
+
+            context.payloadEncoded = true;
+
+            return true;
+        }
+
+        static size_t encodingReadCallback(char* buffer, const size_t size, size_t nitems, void* userp)
+        {
+            auto* context = static_cast<TransferContext*>(userp);
+
+            auto& encoded = context->encodedPayload;
+
+            while (context->encodedPayloadOffset == encoded.size() && !context->payloadEncoded)
+            {
+                char input[16384];
+
+                encoded.clear();
+                context->encodedPayloadOffset = 0;
+
+                const size_t read = context->payloadFile ? context->payloadFile->read(input, sizeof(input)) : context->request->payloadReader(input, sizeof(input));
+
+                // Pausing is not possible in the middle of the compressed stream, so anything but data aborts the transfer
+                if (read > sizeof(input))
+                {
+                    return CURL_READFUNC_ABORT;
+                }
+
+                if (!context->payloadEncoder->encode(input, read, read == 0, encoded))
+                {
+                    context->errorMessage = "Payload could not be compressed";
+
+                    return CURL_READFUNC_ABORT;
+                }
+
+                context->payloadEncoded = read == 0;
+            }
+
+            const auto count = std::min(encoded.size() - context->encodedPayloadOffset, size * nitems);
+
+            std::memcpy(buffer, encoded.data() + context->encodedPayloadOffset, count);
+
+            context->encodedPayloadOffset += count;
+
+            return count;
+        }
+
+        static size_t readCallback(char* buffer, const size_t size, size_t nitems, void* userp)
+        {
+            const auto* self = static_cast<TransferContext*>(userp)->request;
+
+            return self->payloadReader(buffer, size * nitems);
+        }
+
+        static int progressCallback(void* userp, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+        {
+            auto* context = static_cast<TransferContext*>(userp);
+
+            if (context->request->cancellationToken->isCancelled())
+            {
+                context->errorMessage = "Request is cancelled";
+
+                return 1;
+            }
+
+            return 0;
+        }
+
+        static size_t headerCallback(char* buffer, const size_t size, size_t nitems, void* userp)
+        {
+            auto& headerBuffer = static_cast<TransferContext*>(userp)->headerBuffer;
+
+            const size_t total = size * nitems;
+
+            // Each response (redirects, 100 Continue etc.) starts with a status line, only the last one is kept
+            if (total >= 5 && std::memcmp(buffer, "HTTP/", 5) == 0)
+            {
+                headerBuffer.clear();
+            }
+
+            headerBuffer.append(buffer, total);
+
+            return total;
+        }
+
+        static size_t streamingWriteCallback(const void* contents, const size_t size, size_t nmemb, void* userp)
+        {
+            auto* context = static_cast<TransferContext*>(userp);
+
+            const size_t total = size * nmemb;
+
+            const auto* data = static_cast<const unsigned char*>(contents);
+
+            context->request->dataCallback(data, total);
+
+            context->bytesStreamed += total;
+
+            return total;
+        }
+
+        static size_t fileReadCallback(char* buffer, const size_t size, size_t nitems, void* userp)
+        {
+            return static_cast<TransferContext*>(userp)->payloadFile->read(buffer, size * nitems);
+        }
+
+        static size_t fileWriteCallback(void* contents, const size_t size, size_t nmemb, void* userp)
+        {
+            auto* context = static_cast<TransferContext*>(userp);
+
+            const size_t total = size * nmemb;
+
+            if (!context->bodyStarted)
+            {
+                context->bodyStarted = true;
+
+#ifdef __linux__
+                curl_off_t contentLength = -1;
+
+                // Allocate the whole file at once to avoid fragmentation and a size update on every write
+                if (curl_easy_getinfo(context->handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &contentLength) == CURLE_OK && contentLength > 0)
+                {
+                    posix_fallocate(fileno(context->downloadFile.get()), 0, static_cast<off_t>(contentLength));
+                }
+#endif
+            }
+
+            if (std::fwrite(contents, 1, total, context->downloadFile.get()) != total)
+            {
+                context->errorMessage = "Download file could not be written: " + context->request->downloadFilePath;
+
+                return 0;
+            }
+
+            context->bytesWritten += total;
+
+            return total;
+        }
+
+        static size_t bufferWriteCallback(void* contents, const size_t size, size_t nmemb, void* userp)
+        {
+            auto* context = static_cast<TransferContext*>(userp);
+
+            const size_t total = size * nmemb;
+
+            if (total > context->request->responseBufferSize - context->bytesWritten)
+            {
+                context->errorMessage = "Response body is larger than the response buffer";
+
+                return 0;
+            }
+
+            std::memcpy(context->request->responseBuffer + context->bytesWritten, contents, total);
+
+            context->bytesWritten += total;
+
+            return total;
+        }
+
+        static size_t textWriteCallback(void* contents, const size_t size, size_t nmemb, void* userp)
+        {
+            auto* context = static_cast<TransferContext*>(userp);
+
+            if (const auto expectedSize = getExpectedBodySize(*context))
+            {
+                context->stringBuffer.reserve(expectedSize);
+            }
+
+            context->stringBuffer.append(static_cast<char*>(contents), size * nmemb);
+
+            return size * nmemb;
+        }
+
+        /**
+         * @brief Appends the data to the last chunk of the rope, or to a new chunk at least as large as the data received so far
+         * If the size of the body is known, it is received into a single chunk of that size. Chunks are at most MaxReservedBodySize
+         */
+        static size_t sharedWriteCallback(void* contents, const size_t size, size_t nmemb, void* userp)
+        {
+            static constexpr size_t MinChunkSize = 64 * 1024;
+
+            auto* context = static_cast<TransferContext*>(userp);
+
+            auto* data = static_cast<char*>(contents);
+            auto remaining = size * nmemb;
+
+            while (remaining > 0)
+            {
+                if (context->sharedChunks.empty() || context->sharedChunks.back().size() == context->sharedChunks.back().capacity())
+                {
+                    curl_off_t contentLength = -1;
+
+                    if (context->sharedChunks.empty())
+                    {
+                        curl_easy_getinfo(context->handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &contentLength);
+                    }
+
+                    context->sharedChunks.emplace_back();
+                    // Content-Length is sent by the server, so it is trusted only up to MaxReservedBodySize
+                    const auto chunkSize = contentLength > 0 ? static_cast<size_t>(contentLength) : std::max(MinChunkSize, context->sharedBytes);
+
+                    context->sharedChunks.back().reserve(std::min(chunkSize, MaxReservedBodySize));
+                }
+
+                auto& chunk = context->sharedChunks.back();
+
+                // Content-Length may be wrong or the body may be decompressed, the rest goes to the next chunk
+                const auto length = std::min(remaining, std::max<size_t>(chunk.capacity() - chunk.size(), 1));
+
+                chunk.append(data, length);
+
+                context->sharedBytes += length;
+                data += length;
+                remaining -= length;
+            }
+
+            return size * nmemb;
+        }
+
+        static size_t binaryWriteCallback(void* contents, const size_t size, size_t nmemb, void* userp)
+        {
+            auto* context = static_cast<TransferContext*>(userp);
+
+            if (const auto expectedSize = getExpectedBodySize(*context))
+            {
+                context->binaryBuffer.reserve(expectedSize);
+            }
+
+            auto& buffer = context->binaryBuffer;
+
+            auto* data = static_cast<unsigned char*>(contents);
+
+            buffer.insert(buffer.end(), data, data + size * nmemb);
+
+            return size * nmemb;
+        }
+
+        static std::string getHostKey(const std::string& url)
+        {
+            const auto schemeEnd = url.find("://");
+            const auto authorityStart = schemeEnd == std::string::npos ? 0 : schemeEnd + 3;
+            const auto authorityEnd = url.find_first_of("/?#", authorityStart);
+
+            std::string key = url.substr(0, authorityEnd);
+
+            const auto userInfoEnd = key.find('@', authorityStart);
+
+            if (userInfoEnd != std::string::npos)
+            {
+                key.erase(authorityStart, userInfoEnd + 1 - authorityStart);
+            }
+
+            std::transform(key.begin(), key.end(), key.begin(), [](const unsigned char c)
+            {
+                return static_cast<char>(std::tolower(c));
+            });
+
+            return key;
+        }
+
+        static std::string formatSeconds(const std::chrono::milliseconds duration)
+        {
+            auto text = std::to_string(duration.count() / 1000);
+
+            const auto fraction = duration.count() % 1000;
+
+            if (fraction != 0)
+            {
+                char buffer[8];
+
+                std::snprintf(buffer, sizeof(buffer), ".%03d", static_cast<int>(fraction));
+
+                text += buffer;
+
+                text.erase(text.find_last_not_of('0') + 1);
+            }
+
+            return text;
+        }
+
+        static std::string escapeSingleQuotes(const std::string& input)
+        {
+            std::string output;
+
+            for (const char c : input)
+            {
+                if (c == '\'')
+                {
+                    output += "'\\''";
+                }
+                else
+                {
+                    output += c;
+                }
+            }
+
+            return output;
+        }
+    };
+
+    /**
+     * @brief Result of a request sent in a batch, along with its position in the batch
+     */
+    struct HttpBatchResult
+    {
+        /**
+         * @brief Index of the request in the vector passed to HttpClient::sendAll
+         */
+        size_t index = 0;
+
+        /**
+         * @brief Result of the request
+         */
+        HttpResult result;
+    };
+
+    /**
+     * @brief Completion queue of the requests sent by HttpClient::sendAll, results are returned in completion order
+     */
+    class HttpBatch
+    {
+    public:
+        /**
+         * @brief Wait for the next completed request
+         *
+         * @return Next completed request, or nothing if the results of all requests are already returned
+         */
+        std::optional<HttpBatchResult> next()
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+
+            if (state->undelivered == 0)
+            {
+                return std::nullopt;
+            }
+
+            state->ready.wait(lock, [this]
+            {
+                return !state->completed.empty();
+            });
+
+            return take();
+        }
+
+        /**
+         * @brief Wait for the next completed request up to the given timeout
+         *
+         * @param timeout: Maximum time to wait
+         * @return Next completed request, or nothing if no request is completed in time or all results are already returned
+         */
+        std::optional<HttpBatchResult> next(const std::chrono::milliseconds timeout)
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+
+            if (state->undelivered == 0)
+            {
+                return std::nullopt;
+            }
+
+            if (!state->ready.wait_for(lock, timeout, [this]
+            {
+                return !state->completed.empty();
+            }))
+            {
+                return std::nullopt;
+            }
+
+            return take();
+        }
+
+        /**
+         * @brief Returns the number of requests in the batch
+         */
+        [[nodiscard]] size_t size() const noexcept
+        {
+            return state->size;
+        }
+
+        /**
+         * @brief Returns the number of results that are not returned by next yet
+         */
+        [[nodiscard]] size_t remaining() const noexcept
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+
+            return state->undelivered;
+        }
+
+    private:
+        friend class HttpClient;
+
+        struct State
+        {
+            std::mutex mutex;
+            std::condition_variable ready;
+            std::deque<HttpBatchResult> completed;
+            size_t size = 0;
+            size_t undelivered = 0;
+
+            void complete(const size_t index, HttpResult&& result)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    completed.push_back({index, std::move(result)});
+                }
+
+                ready.notify_one();
+            }
+        };
+
+        std::shared_ptr<State> state = std::make_shared<State>();
+
+        std::optional<HttpBatchResult> take()
+        {
+            auto result = std::move(state->completed.front());
+
+            state->completed.pop_front();
+            state->undelivered--;
+
+            return result;
+        }
+    };
+
+    /**
+     * @brief HTTP client that runs requests on a small number of event loop threads
+     * instead of starting a new thread for every request
+     * Each event loop drives a curl_multi handle, so thousands of concurrent requests can be
+     * processed by a handful of threads and connections are reused between the requests
+     */
+    class HttpClient
+    {
+    public:
+        /**
+         * @brief Constructor for the HttpClient class
+         *
+         * @param threadCount: Number of event loop threads (at least 1)
+         */
+        explicit HttpClient(const int threadCount = 1)
+        {
+            CurlGlobalInitializer::initialize();
+
+            for (int i = 0; i < std::max(threadCount, 1); i++)
+            {
+                loops.push_back(std::make_unique<EventLoop>());
+            }
+        }
+
+        /**
+         * @brief Stops the event loops, requests that are still in progress are completed with an error
+         */
+        ~HttpClient()
+        {
+            // Callbacks of the stopped requests may send new ones, they must not reach the loops being destroyed
+            stopped = true;
+
+            loops.clear();
+        }
+
+        HttpClient(const HttpClient&) = delete;
+
+        HttpClient& operator=(const HttpClient&) = delete;
+
+        /**
+         * @brief Process-wide client with a single event loop, used by the APIs that don't take a client
+         *
+         * @return Shared client instance
+         */
+        static std::shared_ptr<HttpClient> shared()
+        {
+            static auto instance = std::make_shared<HttpClient>();
+
+            return instance;
+        }
+
+        /**
+         * @brief Send the HTTP request on one of the event loops and return the result as a future
+         * The request is copied, so the HttpRequest object does not need to outlive the call
+         *
+         * @param request: Request to be sent
+         *
+         * @return Result of the request as a future (see HttpResult object for details)
+         */
+        std::future<HttpResult> send(const HttpRequest& request) noexcept
+        {
+            auto promise = std::make_shared<std::promise<HttpResult>>();
+
+            auto future = promise->get_future();
+
+            submit(request, [promise](HttpResult&& result)
+            {
+                promise->set_value(std::move(result));
+            });
+
+            return future;
+        }
+
+        /**
+         * @brief Send the HTTP request on one of the event loops and call the given function with the result
+         * No future is created, the function is called directly on the event loop thread, so it should return
+         * quickly. The request is copied, so the HttpRequest object does not need to outlive the call
+         *
+         * @param request: Request to be sent
+         * @param onComplete: Function to be called with the result (see HttpResult object for details)
+         */
+        void send(const HttpRequest& request, std::function<void(HttpResult&&)> onComplete) noexcept
+        {
+            submit(request, std::move(onComplete));
+        }
+
+        /**
+         * @brief Send all requests at once on the event loops and return their results in completion order
+         *
+         * @param requests: Requests to be sent
+         *
+         * @return Completion queue to read the results from as the requests complete
+         */
+        HttpBatch sendAll(std::vector<HttpRequest> requests) noexcept
+        {
+            HttpBatch batch;
+
+            batch.state->size = requests.size();
+            batch.state->undelivered = requests.size();
+
+            for (size_t i = 0; i < requests.size(); i++)
+            {
+                submit(std::move(requests[i]), [state = batch.state, i](HttpResult&& result)
+                {
+                    state->complete(i, std::move(result));
+                });
+            }
+
+            return batch;
+        }
+
+        /**
+         * @brief Send all requests at once on the event loops and return all results when the last one is completed
+         *
+         * @param requests: Requests to be sent
+         *
+         * @return Results in the order of the requests as a future
+         */
+        std::future<std::vector<HttpResult>> whenAll(std::vector<HttpRequest> requests) noexcept
+        {
+            struct State
+            {
+                std::promise<std::vector<HttpResult>> promise;
+                std::vector<HttpResult> results;
+                std::atomic<size_t> pending{0};
+            };
+
+            auto state = std::make_shared<State>();
+
+            auto future = state->promise.get_future();
+
+            if (requests.empty())
+            {
+                state->promise.set_value({});
+
+                return future;
+            }
+
+            state->results.resize(requests.size());
+            state->pending = requests.size();
+
+            for (size_t i = 0; i < requests.size(); i++)
+            {
+                submit(std::move(requests[i]), [state, i](HttpResult&& result)
+                {
+                    // Every request writes to its own slot, the last one to complete publishes the vector
+                    state->results[i] = std::move(result);
+
+                    if (state->pending.fetch_sub(1) == 1)
+                    {
+                        state->promise.set_value(std::move(state->results));
+                    }
+                });
+            }
+
+            return future;
+        }
+
+        /**
+         * @brief Send all requests at once on the event loops and return the first successful result
+         * If all requests fail, the result of the last failed one is returned. The remaining requests are
+         * not cancelled, their results are discarded
+         *
+         * @param requests: Requests to be sent
+         *
+         * @return First successful result and the index of its request as a future
+         */
+        std::future<HttpBatchResult> whenAny(std::vector<HttpRequest> requests) noexcept
+        {
+            struct State
+            {
+                std::promise<HttpBatchResult> promise;
+                std::atomic<size_t> pending{0};
+                std::atomic<bool> done{false};
+            };
+
+            auto state = std::make_shared<State>();
+
+            auto future = state->promise.get_future();
+
+            if (requests.empty())
+            {
+                state->promise.set_value({0, {false, "", {}, 0, "No request to send"}});
+
+                return future;
+            }
+
+            state->pending = requests.size();
+
+            for (size_t i = 0; i < requests.size(); i++)
+            {
+                submit(std::move(requests[i]), [state, i](HttpResult&& result)
+                {
+                    const bool last = state->pending.fetch_sub(1) == 1;
+
+                    if ((result.succeed || last) && !state->done.exchange(true))
+                    {
+                        state->promise.set_value({i, std::move(result)});
+                    }
+                });
+            }
+
+            return future;
+        }
+
+        /**
+         * @brief Set the maximum number of concurrent HTTP/2 streams on a single connection
+         * Requests to the same host are multiplexed as streams over one connection up to this limit
+         *
+         * @param maxStreams: Maximum number of streams per connection (1 - 2147483647, default 100)
+         */
+        HttpClient& setMaxStreamsPerConnection(const int maxStreams) noexcept
+        {
+            for (auto& loop : loops)
+            {
+                loop->setOption(CURLMOPT_MAX_CONCURRENT_STREAMS, maxStreams);
+            }
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the maximum number of connections opened to a single host by each event loop
+         *
+         * @param maxConnections: Maximum number of connections per host (0 for no limit)
+         */
+        HttpClient& setMaxConnectionsPerHost(const int maxConnections) noexcept
+        {
+            for (auto& loop : loops)
+            {
+                loop->setOption(CURLMOPT_MAX_HOST_CONNECTIONS, maxConnections);
+            }
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the pool that the response buffers of all requests sent by the client will be taken from
+         * Requests that have their own pool set by HttpRequest::setResponseBufferPool keep using it
+         *
+         * @param pool: Response buffer pool to be used (nullptr allocates new buffers for every response)
+         */
+        HttpClient& setResponseBufferPool(std::shared_ptr<ResponseBufferPool> pool) noexcept
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            this->responseBufferPool = std::move(pool);
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the metrics registry that the counters and latencies of all requests sent by the client will be recorded to
+         * Requests that have their own registry set by HttpRequest::setMetrics keep using it
+         *
+         * @param metrics: Metrics registry to be used (nullptr disables recording)
+         */
+        HttpClient& setMetrics(std::shared_ptr<HttpMetrics> metrics) noexcept
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            this->metrics = std::move(metrics);
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the retry policy of all requests sent by the client, they all share the budget of the policy
+         * Requests that have their own policy set by HttpRequest::setRetryPolicy keep using it
+         *
+         * @param policy: Retry settings (see RetryPolicy)
+         */
+        HttpClient& setRetryPolicy(RetryPolicy policy) noexcept
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            this->retryPolicy = std::move(policy);
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the coalescer that identical GET requests sent by the client at the same time will share a transfer through
+         * Requests that have their own coalescer set by HttpRequest::setCoalescer keep using it
+         *
+         * @param coalescer: Coalescer to be used (nullptr disables coalescing)
+         */
+        HttpClient& setCoalescer(std::shared_ptr<RequestCoalescer> coalescer) noexcept
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            this->coalescer = std::move(coalescer);
+
+            return *this;
+        }
+
+        /**
+         * @brief Set the cache that the responses of all requests sent by the client will be served from and stored in
+         * Requests that have their own cache set by HttpRequest::setCache keep using it
+         *
+         * @param cache: Cache to be used (nullptr disables caching)
+         */
+        HttpClient& setCache(std::shared_ptr<HttpCache> cache) noexcept
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            this->cache = std::move(cache);
+
+            return *this;
+        }
+
+    private:
+        friend class HttpRequestAwaiter;
+
+        /**
+         * @brief A request waiting for or being processed by an event loop
+         */
+        struct Transfer
+        {
+            HttpRequest request;
+            HttpRequest::TransferContext context;
+            std::function<void(HttpResult&&)> onComplete;
+            size_t cancellationSubscription = 0;
+
+            Transfer(HttpRequest&& request, std::function<void(HttpResult&&)> onComplete)
+                : request(std::move(request)), onComplete(std::move(onComplete))
+            {
+            }
+        };
+
+        class EventLoop
+        {
+        public:
+            EventLoop()
+            {
+                multi = curl_multi_init();
+
+                curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+                thread = std::thread([this]
+                {
+                    run();
+                });
+            }
+
+            ~EventLoop()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    stopping = true;
+                }
+
+                curl_multi_wakeup(multi);
+
+                thread.join();
+
+                curl_multi_cleanup(multi);
+            }
+
+            EventLoop(const EventLoop&) = delete;
+
+            EventLoop& operator=(const EventLoop&) = delete;
+
+            void enqueue(std::unique_ptr<Transfer> transfer)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    if (!stopping)
+                    {
+                        pending.push_back(std::move(transfer));
+                    }
+                }
+
+                if (transfer)
+                {
+                    transfer->onComplete({false, "", {}, 0, "HttpClient is stopped"});
+
+                    return;
+                }
+
+                curl_multi_wakeup(multi);
+            }
+
+            bool schedule(const std::chrono::steady_clock::duration delay, std::function<void()> task)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    if (stopping)
+                    {
+                        return false;
+                    }
+
+                    timers.emplace(std::chrono::steady_clock::now() + delay, std::move(task));
+                }
+
+                curl_multi_wakeup(multi);
+
+                return true;
+            }
+
+            void setOption(const CURLMoption option, const long value)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    pendingOptions.emplace_back(option, value);
+                }
+
+                curl_multi_wakeup(multi);
+            }
+
+        private:
+            CURLM* multi = nullptr;
+            std::thread thread;
+            std::mutex mutex;
+            bool stopping = false;
+            std::vector<std::unique_ptr<Transfer>> pending;
+            std::vector<std::pair<CURLMoption, long>> pendingOptions;
+            std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> timers;
+            std::map<CURL*, std::unique_ptr<Transfer>> active;
+            std::vector<CURL*> idleHandles;
+            std::atomic<bool> cancellationRequested{false};
+
+            void run()
+            {
+                while (true)
+                {
+                    std::vector<std::unique_ptr<Transfer>> incoming;
+                    std::vector<std::pair<CURLMoption, long>> options;
+                    std::vector<std::function<void()>> dueTasks;
+                    int pollTimeout = 1000;
+
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+
+                        if (stopping)
+                        {
+                            break;
+                        }
+
+                        incoming.swap(pending);
+                        options.swap(pendingOptions);
+
+                        const auto now = std::chrono::steady_clock::now();
+
+                        while (!timers.empty() && timers.begin()->first <= now)
+                        {
+                            dueTasks.push_back(std::move(timers.begin()->second));
+
+                            timers.erase(timers.begin());
+                        }
+
+                        if (!timers.empty())
+                        {
+                            const auto untilNext = std::chrono::ceil<std::chrono::milliseconds>(timers.begin()->first - now);
+
+                            pollTimeout = static_cast<int>(std::min<long long>(untilNext.count(), pollTimeout));
+                        }
+                    }
+
+                    // Tasks may send new requests, so they are run without holding the lock
+                    for (auto& task : dueTasks)
+                    {
+                        task();
+                    }
+
+                    // Multi handle is not thread safe, so the options are applied by the loop thread
+                    for (const auto& option : options)
+                    {
+                        curl_multi_setopt(multi, option.first, option.second);
+                    }
+
+                    for (auto& transfer : incoming)
+                    {
+                        start(std::move(transfer));
+                    }
+
+                    int running = 0;
+
+                    curl_multi_perform(multi, &running);
+
+                    int messagesLeft = 0;
+
+                    while (const CURLMsg* message = curl_multi_info_read(multi, &messagesLeft))
+                    {
+                        if (message->msg == CURLMSG_DONE)
+                        {
+                            finish(message->easy_handle, message->data.result);
+                        }
+                    }
+
+                    if (cancellationRequested.exchange(false))
+                    {
+                        abortCancelledTransfers();
+                    }
+
+                    curl_multi_poll(multi, nullptr, 0, pollTimeout, nullptr);
+                }
+
+                for (auto& transfer : active)
+                {
+                    curl_multi_remove_handle(multi, transfer.first);
+                    curl_easy_cleanup(transfer.first);
+
+                    if (transfer.second->request.metrics)
+                    {
+                        transfer.second->request.metrics->transferStopped();
+                    }
+
+                    if (transfer.second->request.cancellationToken)
+                    {
+                        transfer.second->request.cancellationToken->unsubscribe(transfer.second->cancellationSubscription);
+                    }
+
+                    transfer.second->onComplete({false, "", {}, 0, "HttpClient is stopped"});
+                }
+
+                active.clear();
+
+                for (auto& transfer : pending)
+                {
+                    transfer->onComplete({false, "", {}, 0, "HttpClient is stopped"});
+                }
+
+                pending.clear();
+
+                std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> remainingTimers;
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    remainingTimers.swap(timers);
+                }
+
+                // Timers are run instead of being dropped, so that the requests waiting for them are completed
+                for (auto& timer : remainingTimers)
+                {
+                    timer.second();
+                }
+
+                for (auto* handle : idleHandles)
+                {
+                    curl_easy_cleanup(handle);
+                }
+
+                idleHandles.clear();
+            }
+
+            void start(std::unique_ptr<Transfer> transfer)
+            {
+                CURL* handle = nullptr;
+
+                if (!idleHandles.empty())
+                {
+                    handle = idleHandles.back();
+
+                    idleHandles.pop_back();
+                }
+                else
+                {
+                    handle = curl_easy_init();
+                }
+
+                if (!handle)
+                {
+                    transfer->onComplete({false, "", {}, 0, "CURL initialization failed"});
+
+                    return;
+                }
+
+                if (!transfer->request.prepare(handle, transfer->context))
+                {
+                    recycle(handle);
+
+                    transfer->onComplete({false, "", {}, 0, std::move(transfer->context.errorMessage)});
+
+                    return;
+                }
+
+                // Wait for a connection that can be multiplexed instead of opening a new one
+                curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L);
+
+                if (curl_multi_add_handle(multi, handle) != CURLM_OK)
+                {
+                    curl_easy_cleanup(handle);
 
-            return *this;
-        }
+                    transfer->onComplete({false, "", {}, 0, "CURL multi handle could not accept the request"});
 
-        /**
-         * @brief Convert the request to a cURL command string
-         * This can be useful for debugging or logging purposes
-         *
-         * @return cURL command string representing the request
-         */
-        [[nodiscard]] std::string toCurlCommand() const noexcept
-        {
-            std::ostringstream cmd;
+                    return;
+                }
 
-            cmd << "curl";
+                if (transfer->request.metrics)
+                {
+                    transfer->request.metrics->transferStarted();
+                }
 
-            cmd << " -X " << method;
+                if (transfer->request.cancellationToken)
+                {
+                    // The loop may be waiting in poll, so it is woken up to abort the transfer immediately
+                    transfer->cancellationSubscription = transfer->request.cancellationToken->subscribe([this]
+                    {
+                        cancellationRequested = true;
 
-            for (const auto& header : headers)
-            {
-                cmd << " -H \"" << header.first << ": " << header.second << "\"";
-            }
+                        curl_multi_wakeup(multi);
+                    });
+                }
 
-            if (!userAgent.empty())
-            {
-                cmd << " -A \"" << userAgent << "\"";
+                active[handle] = std::move(transfer);
             }
 
-            if (timeout > 0)
+            void finish(CURL* handle, const CURLcode res)
             {
-                cmd << " --max-time " << timeout;
-            }
+                const auto found = active.find(handle);
 
-            if (sslErrorsWillBeIgnored)
-            {
-                cmd << " -k";
+                if (found == active.end())
+                {
+                    return;
+                }
+
+                auto transfer = std::move(found->second);
+
+                active.erase(found);
+
+                if (transfer->request.cancellationToken)
+                {
+                    transfer->request.cancellationToken->unsubscribe(transfer->cancellationSubscription);
+                }
+
+                auto result = HttpRequest::complete(transfer->context, res);
+
+                curl_multi_remove_handle(multi, handle);
+
+                recycle(handle);
+
+                transfer->onComplete(std::move(result));
             }
 
-            if (downloadBandwidthLimit > 0)
+            void abortCancelledTransfers()
             {
-                cmd << " --limit-rate " << downloadBandwidthLimit;
+                std::vector<CURL*> cancelled;
+
+                for (const auto& transfer : active)
+                {
+                    const auto& token = transfer.second->request.cancellationToken;
+
+                    if (token && token->isCancelled())
+                    {
+                        transfer.second->context.errorMessage = "Request is cancelled";
+
+                        cancelled.push_back(transfer.first);
+                    }
+                }
+
+                for (auto* handle : cancelled)
+                {
+                    finish(handle, CURLE_ABORTED_BY_CALLBACK);
+                }
             }
 
-            if (!payload.empty())
+            void recycle(CURL* handle)
             {
-                cmd << " --data '" << escapeSingleQuotes(payload) << "'";
-            }
+                curl_easy_reset(handle);
 
-            cmd << " \"" << url << "\"";
+                // The handle may be used with another connection pool next time, and this one may be destroyed until then
+                curl_easy_setopt(handle, CURLOPT_SHARE, nullptr);
 
-            return cmd.str();
-        }
+                idleHandles.push_back(handle);
+            }
+        };
 
         /**
-         * @brief Send the HTTP request and return the result as a future
-         * The result can be obtained by calling the get() method of the future
-         * get() method will block until the result is available so it is recommended to use it
-         * when you need the result and no more other http requests will be made as parallel
-         *
-         * @return Result of the request as a future (see HttpResult object for details)
+         * @brief Attempts of a hedged request that are racing each other
          */
-        std::future<HttpResult> send() noexcept
+        struct Hedge
         {
-            return this->sendRequest();
-        }
+            HttpRequest request;
+            HedgingPolicy policy;
+            std::function<void(HttpResult&&)> onComplete;
+            CancellationToken attemptsToken;
+            std::optional<CancellationToken> userToken;
+            size_t userSubscription = 0;
+            EventLoop* timerLoop = nullptr;
+            std::mutex mutex;
+            int launched = 0;
+            int finished = 0;
+            bool done = false;
 
-    private:
-        enum class ReturnFormat
-        {
-            TEXT,
-            BINARY
+            Hedge(HttpRequest&& request, HedgingPolicy&& policy, std::function<void(HttpResult&&)> onComplete)
+                : request(std::move(request)), policy(std::move(policy)), onComplete(std::move(onComplete))
+            {
+            }
         };
 
-        const char* HttpMethodStrings[5] = {
-            "GET",
-            "POST",
-            "PUT",
-            "DELETE",
-            "PATCH"
+        /**
+         * @brief Request that is retried by the client according to its retry policy
+         */
+        struct Retry
+        {
+            HttpRequest request;
+            std::function<void(HttpResult&&)> onComplete;
+            EventLoop* timerLoop = nullptr;
+            std::atomic<bool> waiting{false};
+            size_t cancellationSubscription = 0;
+
+            Retry(HttpRequest&& request, std::function<void(HttpResult&&)> onComplete)
+                : request(std::move(request)), onComplete(std::move(onComplete))
+            {
+            }
         };
 
-        std::string url;
-        std::string method = "GET";
-        std::string payload;
-        std::string userAgent;
-        bool sslErrorsWillBeIgnored = false;
-        ReturnFormat returnFormat = ReturnFormat::TEXT;
-        std::map<std::string, std::string> headers;
-        int timeout = 0;
-        int uploadBandwidthLimit = 0;
-        int downloadBandwidthLimit = 0;
-        TLSVersion tlsVersion = TLSVersion::DEFAULT;
+        std::vector<std::unique_ptr<EventLoop>> loops;
+        std::atomic<size_t> nextLoop{0};
+        std::atomic<bool> stopped{false};
+        std::mutex mutex;
+        std::shared_ptr<ResponseBufferPool> responseBufferPool;
+        std::shared_ptr<HttpMetrics> metrics;
+        std::optional<RetryPolicy> retryPolicy;
+        std::shared_ptr<HttpCache> cache;
+        std::shared_ptr<RequestCoalescer> coalescer;
 
-        struct CurlDeleter
+        void submit(HttpRequest request, std::function<void(HttpResult&&)> onComplete) noexcept
         {
-            void operator()(CURL* ptr) const
+            if (stopped)
             {
-                if (ptr)
-                {
-                    curl_easy_cleanup(ptr);
-                }
+                onComplete({false, "", {}, 0, "HttpClient is stopped"});
+
+                return;
             }
-        };
 
-        struct CurlSlistDeleter
-        {
-            void operator()(curl_slist* ptr) const
             {
-                if (ptr)
+                std::lock_guard<std::mutex> lock(mutex);
+
+                if (!request.cache)
                 {
-                    curl_slist_free_all(ptr);
+                    request.cache = cache;
+                }
+
+                if (!request.coalescer)
+                {
+                    request.coalescer = coalescer;
                 }
             }
-        };
 
-        std::function<void(const unsigned char* data, size_t dataLength)> dataCallback;
+            // Cache hits are completed on the calling thread without reaching an event loop
+            if (auto cached = request.cachedResult())
+            {
+                onComplete(std::move(*cached));
 
-        std::future<HttpResult> sendRequest() noexcept
-        {
-            return std::async(std::launch::async, [this]() -> HttpResult
+                return;
+            }
+
+            if (request.isCoalesced())
             {
-                std::unique_ptr<CURL, CurlDeleter> curl(curl_easy_init());
+                const auto key = request.coalescingKey();
 
-                if (!curl)
+                auto requestCoalescer = std::move(request.coalescer);
+
+                if (!requestCoalescer->join(key, std::move(onComplete)))
                 {
-                    return {false, "", {}, 0, "CURL initialization failed"};
+                    return;
                 }
 
-                std::unique_ptr<curl_slist, CurlSlistDeleter> headerList(nullptr);
+                // The body is received into a shared buffer, so all callers get the same one without copying it
+                request.returnFormat = HttpRequest::ReturnFormat::SHARED;
 
-                for (const auto& header : this->headers)
+                // Only the first request is sent, its result completes all requests waiting for the same key
+                onComplete = [requestCoalescer, key](HttpResult&& result)
                 {
-                    std::string headerStr = header.first + ": " + header.second;
+                    requestCoalescer->finish(key, std::move(result));
+                };
+            }
 
-                    headerList.reset(curl_slist_append(headerList.release(), headerStr.c_str()));
-                }
+            if (request.hedgingPolicy)
+            {
+                submitHedged(std::move(request), std::move(onComplete));
+
+                return;
+            }
+
+            if (!request.retryPolicy)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
 
-                std::string stringBuffer;
-                std::vector<unsigned char> binaryBuffer;
-                long statusCode = 0;
+                request.retryPolicy = retryPolicy;
+            }
+
+            if (request.retryPolicy)
+            {
+                submitRetried(std::move(request), std::move(onComplete));
+
+                return;
+            }
+
+            dispatch(std::move(request), std::move(onComplete));
+        }
+
+        void dispatch(HttpRequest request, std::function<void(HttpResult&&)> onComplete) noexcept
+        {
+            if (stopped)
+            {
+                onComplete({false, "", {}, 0, "HttpClient is stopped"});
+
+                return;
+            }
 
-                curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, headerList.get());
-                curl_easy_setopt(curl.get(), CURLOPT_URL, this->url.c_str());
-                curl_easy_setopt(curl.get(), CURLOPT_CUSTOMREQUEST, this->method.c_str());
-                curl_easy_setopt(curl.get(), CURLOPT_SSL_VERIFYPEER, this->sslErrorsWillBeIgnored ? 0L : 1L);
-                curl_easy_setopt(curl.get(), CURLOPT_SSL_VERIFYHOST, this->sslErrorsWillBeIgnored ? 0L : 1L);
-                curl_easy_setopt(curl.get(), CURLOPT_SSLVERSION, static_cast<long>(this->tlsVersion));
-                curl_easy_setopt(curl.get(), CURLOPT_TIMEOUT, this->timeout);
-                curl_easy_setopt(curl.get(), CURLOPT_MAX_SEND_SPEED_LARGE, static_cast<curl_off_t>(this->uploadBandwidthLimit));
-                curl_easy_setopt(curl.get(), CURLOPT_MAX_RECV_SPEED_LARGE, static_cast<curl_off_t>(this->downloadBandwidthLimit));
+            auto transfer = std::make_unique<Transfer>(std::move(request), std::move(onComplete));
 
-                if (!this->userAgent.empty())
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                if (!transfer->request.responseBufferPool)
                 {
-                    curl_easy_setopt(curl.get(), CURLOPT_USERAGENT, this->userAgent.c_str());
+                    transfer->request.responseBufferPool = responseBufferPool;
                 }
 
-                if (!this->payload.empty())
+                if (!transfer->request.metrics)
                 {
-                    curl_easy_setopt(curl.get(), CURLOPT_POSTFIELDS, this->payload.c_str());
+                    transfer->request.metrics = metrics;
                 }
+            }
+
+            auto& loop = loops[nextLoop++ % loops.size()];
 
-                if (dataCallback)
+            loop->enqueue(std::move(transfer));
+        }
+
+        void submitRetried(HttpRequest request, std::function<void(HttpResult&&)> onComplete) noexcept
+        {
+            request.retryPolicy->requestStarted();
+
+            auto retry = std::make_shared<Retry>(std::move(request), std::move(onComplete));
+
+            retry->timerLoop = loops[nextLoop++ % loops.size()].get();
+
+            sendRetryAttempt(retry, 0);
+        }
+
+        void sendRetryAttempt(const std::shared_ptr<Retry>& retry, const int attempt) noexcept
+        {
+            HttpRequest request = retry->request;
+
+            request.retryPolicy.reset();
+
+            dispatch(std::move(request), [this, retry, attempt](HttpResult&& result)
+            {
+                result.attempt = attempt;
+
+                const auto delay = retry->request.retryDelay(result, attempt);
+
+                if (!delay)
                 {
-                    curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, streamingWriteCallback);
-                    curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, this);
+                    retry->onComplete(std::move(result));
+
+                    return;
                 }
-                else if (this->returnFormat == ReturnFormat::BINARY)
+
+                retryLater(retry, attempt + 1, *delay);
+            });
+        }
+
+        void retryLater(const std::shared_ptr<Retry>& retry, const int attempt, const std::chrono::milliseconds delay) noexcept
+        {
+            retry->waiting = true;
+
+            const auto& token = retry->request.cancellationToken;
+
+            if (token)
+            {
+                // A request cancelled during the backoff doesn't wait for it, its next attempt fails immediately
+                retry->cancellationSubscription = token->subscribe([this, retry, attempt]
                 {
-                    curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, binaryWriteCallback);
-                    curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &binaryBuffer);
-                }
-                else
+                    resumeRetry(retry, attempt);
+                });
+            }
+
+            const auto scheduled = retry->timerLoop->schedule(delay, [this, retry, attempt]
+            {
+                if (retry->request.cancellationToken)
                 {
-                    curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, textWriteCallback);
-                    curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &stringBuffer);
+                    retry->request.cancellationToken->unsubscribe(retry->cancellationSubscription);
                 }
 
-                const auto res = curl_easy_perform(curl.get());
-                curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &statusCode);
+                resumeRetry(retry, attempt);
+            });
 
-                if (res == CURLE_OK && statusCode >= 200 && statusCode < 300)
-                {
-                    return {
-                        true,
-                        std::move(stringBuffer),
-                        std::move(binaryBuffer),
-                        static_cast<int>(statusCode),
-                        ""
-                    };
-                }
-                else
+            if (!scheduled)
+            {
+                if (token)
                 {
-                    std::string err = curl_easy_strerror(res);
-                    if (res == CURLE_OK)
-                    {
-                        err = "HTTP Error: " + std::to_string(statusCode);
-                    }
-                    return {
-                        false,
-                        std::move(stringBuffer),
-                        std::move(binaryBuffer),
-                        static_cast<int>(statusCode),
-                        std::move(err)
-                    };
+                    token->unsubscribe(retry->cancellationSubscription);
                 }
-            });
+
+                resumeRetry(retry, attempt);
+            }
         }
 
-        static size_t streamingWriteCallback(const void* contents, const size_t size, size_t nmemb, void* userp)
+        void resumeRetry(const std::shared_ptr<Retry>& retry, const int attempt) noexcept
         {
-            const auto* self = static_cast<HttpRequest*>(userp);
+            if (retry->waiting.exchange(false))
+            {
+                sendRetryAttempt(retry, attempt);
+            }
+        }
 
-            const size_t total = size * nmemb;
+        void submitHedged(HttpRequest request, std::function<void(HttpResult&&)> onComplete) noexcept
+        {
+            auto policy = std::move(*request.hedgingPolicy);
 
-            const auto* data = static_cast<const unsigned char*>(contents);
+            request.hedgingPolicy.reset();
 
-            self->dataCallback(data, total);
+            // Duplicates would share the payload stream, the download file or the response buffer
+            if (request.payloadReader || !request.downloadFilePath.empty() || request.responseBuffer)
+            {
+                submit(std::move(request), std::move(onComplete));
 
-            return total;
-        }
+                return;
+            }
 
-        static size_t textWriteCallback(void* contents, const size_t size, size_t nmemb, void* userp)
-        {
-            static_cast<std::string*>(userp)->append(static_cast<char*>(contents), size * nmemb);
+            auto hedge = std::make_shared<Hedge>(std::move(request), std::move(policy), std::move(onComplete));
 
-            return size * nmemb;
+            // Attempts share a token of their own, so the losers can be cancelled without cancelling the user's token
+            hedge->userToken = std::move(hedge->request.cancellationToken);
+            hedge->request.cancellationToken = hedge->attemptsToken;
+            hedge->timerLoop = loops[nextLoop++ % loops.size()].get();
+
+            if (hedge->userToken)
+            {
+                hedge->userSubscription = hedge->userToken->subscribe([attemptsToken = hedge->attemptsToken]() mutable
+                {
+                    attemptsToken.cancel();
+                });
+            }
+
+            launchAttempt(hedge);
         }
 
-        static size_t binaryWriteCallback(void* contents, const size_t size, size_t nmemb, void* userp)
+        void launchAttempt(const std::shared_ptr<Hedge>& hedge) noexcept
         {
-            auto& buffer = *static_cast<std::vector<unsigned char>*>(userp);
+            int attempt = 0;
 
-            auto* data = static_cast<unsigned char*>(contents);
+            {
+                std::lock_guard<std::mutex> lock(hedge->mutex);
 
-            buffer.insert(buffer.end(), data, data + size * nmemb);
+                if (hedge->done || hedge->launched >= hedge->policy.maxAttempts)
+                {
+                    return;
+                }
 
-            return size * nmemb;
+                attempt = hedge->launched++;
+            }
+
+            HttpRequest request = hedge->request;
+
+            request.url = hedge->policy.urlFor(attempt, hedge->request.url);
+
+            const auto startedAt = std::chrono::steady_clock::now();
+
+            submit(std::move(request), [this, hedge, attempt, startedAt](HttpResult&& result)
+            {
+                completeAttempt(hedge, attempt, startedAt, std::move(result));
+            });
+
+            if (attempt + 1 < hedge->policy.maxAttempts && !stopped)
+            {
+                hedge->timerLoop->schedule(hedge->policy.getDelay(), [this, hedge]
+                {
+                    launchAttempt(hedge);
+                });
+            }
         }
 
-        static std::string escapeSingleQuotes(const std::string& input)
+        void completeAttempt(const std::shared_ptr<Hedge>& hedge, const int attempt, const std::chrono::steady_clock::time_point startedAt, HttpResult&& result) noexcept
         {
-            std::string output;
+            bool launchNext = false;
 
-            for (const char c : input)
             {
-                if (c == '\'')
+                std::lock_guard<std::mutex> lock(hedge->mutex);
+
+                hedge->finished++;
+
+                if (hedge->done)
                 {
-                    output += "'\\''";
+                    return;
                 }
-                else
+
+                // A redirect or a client error is what any replica would return, so it is not raced any further
+                const bool final = result.succeed || (result.statusCode >= 300 && result.statusCode < 500);
+
+                if (!final)
                 {
-                    output += c;
+                    if (hedge->finished < hedge->launched)
+                    {
+                        return;
+                    }
+
+                    // Every attempt sent so far has failed, so the next one is sent without waiting for the delay
+                    launchNext = hedge->launched < hedge->policy.maxAttempts && !hedge->attemptsToken.isCancelled() && !stopped;
                 }
+
+                hedge->done = !launchNext;
             }
 
-            return output;
+            if (launchNext)
+            {
+                launchAttempt(hedge);
+
+                return;
+            }
+
+            if (result.succeed)
+            {
+                hedge->policy.latencies->record(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startedAt));
+            }
+
+            hedge->attemptsToken.cancel();
+
+            if (hedge->userToken)
+            {
+                hedge->userToken->unsubscribe(hedge->userSubscription);
+            }
+
+            result.attempt = attempt;
+
+            hedge->onComplete(std::move(result));
         }
     };
+
+    inline void HttpRequest::send(std::function<void(HttpResult&&)> onComplete) const noexcept
+    {
+        HttpClient::shared()->send(*this, std::move(onComplete));
+    }
+
+    inline std::future<HttpResult> HttpRequest::sendOnSharedClient() const noexcept
+    {
+        return HttpClient::shared()->send(*this);
+    }
+
+    inline void HttpRequest::revalidateInBackground() const noexcept
+    {
+        HttpRequest revalidation(*this);
+
+        revalidation.backgroundRevalidation = true;
+        revalidation.hedgingPolicy.reset();
+
+        HttpClient::shared()->send(revalidation, [cache = this->cache, url = this->url](HttpResult&&)
+        {
+            cache->endRevalidation(url);
+        });
+    }
 }
 
 #endif //LIBCPP_HTTP_CLIENT_HPP
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include "libcpp-http-client-coro.hpp"
+
+using namespace lklibs;
+
+/**
+ * @brief Minimal eagerly started coroutine type, the future is ready when the coroutine returns
+ */
+struct Task
+{
+    struct promise_type
+    {
+        std::promise<void> done;
+
+        Task get_return_object()
+        {
+            return {done.get_future()};
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void()
+        {
+            done.set_value();
+        }
+
+        void unhandled_exception()
+        {
+            done.set_exception(std::current_exception());
+        }
+    };
+
+    std::future<void> done;
+};
+
+/**
+ * @brief Executor that runs the tasks on a new thread and counts them
+ */
+class CountingExecutor : public Executor
+{
+public:
+    std::atomic<int> executed{0};
+
+    bool execute(std::function<void()> task) noexcept override
+    {
+        executed++;
+
+        std::thread(std::move(task)).detach();
+
+        return true;
+    }
+};
+
+// Coroutines take their state as parameters, since the captures of a lambda coroutine don't live as long as its frame
+Task awaitRequest(HttpResult& response)
+{
+    response = co_await HttpRequest("https://httpbun.com/get");
+}
+
+Task awaitRequestsOnClient(HttpClient& client, std::vector<HttpResult>& responses)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        responses.push_back(co_await sendAsync(client, HttpRequest("https://httpbun.com/get")));
+    }
+}
+
+Task awaitRequestOnExecutor(Executor& executor, HttpResult& response, std::thread::id& resumedOn)
+{
+    response = co_await sendAsync(HttpRequest("https://httpbun.com/get"), &executor);
+
+    resumedOn = std::this_thread::get_id();
+}
+
+TEST(CoroutineTest, HttpRequestCanBeAwaited)
+{
+    HttpResult response;
+
+    awaitRequest(response).done.get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+}
+
+TEST(CoroutineTest, HttpRequestCanBeAwaitedOnAClient)
+{
+    HttpClient client(2);
+
+    std::vector<HttpResult> responses;
+
+    awaitRequestsOnClient(client, responses).done.get();
+
+    ASSERT_EQ(responses.size(), 3) << "Response count is invalid";
+
+    for (const auto& response : responses)
+    {
+        ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    }
+}
+
+TEST(CoroutineTest, CoroutineMustBeResumedOnTheExecutor)
+{
+    CountingExecutor executor;
+
+    HttpResult response;
+    std::thread::id resumedOn;
+
+    awaitRequestOnExecutor(executor, response, resumedOn).done.get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(executor.executed, 1) << "Coroutine is not resumed on the executor";
+    ASSERT_NE(resumedOn, std::this_thread::get_id()) << "Coroutine is resumed on the caller thread";
+}
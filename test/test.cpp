@@ -1,6 +1,8 @@
 #include "libcpp-http-client.hpp"
 #include <nlohmann/json.hpp>
 #include <gtest/gtest.h>
+#include <fstream>
+#include <set>
 
 using namespace lklibs;
 using json = nlohmann::json;
@@ -773,6 +775,229 @@ TEST(TimeoutTest, TimeoutCanBeSet)
     ASSERT_FALSE(response.errorMessage.empty()) << "HTTP Error Message is empty";
 }
 
+TEST(TimeoutTest, TimeoutCanBeSetInMilliseconds)
+{
+    HttpRequest httpRequest("https://httpbun.com/delay/3");
+
+    auto response = httpRequest.setTimeout(std::chrono::milliseconds(500)).send().get();
+
+    ASSERT_FALSE(response.succeed) << "HTTP Request is not failed";
+    ASSERT_EQ(response.errorMessage, curl_easy_strerror(CURLE_OPERATION_TIMEDOUT)) << "HTTP Error Message is invalid";
+}
+
+TEST(TimeoutTest, RequestMustFailIfTheDeadlineHasPassed)
+{
+    HttpRequest httpRequest("https://httpbun.com/get");
+
+    auto response = httpRequest.setDeadline(std::chrono::steady_clock::now() - std::chrono::seconds(1)).send().get();
+
+    ASSERT_FALSE(response.succeed) << "HTTP Request is not failed";
+    ASSERT_EQ(response.errorMessage, "Deadline exceeded") << "HTTP Error Message is invalid";
+}
+
+TEST(TimeoutTest, DeadlineMustLimitTheTimeout)
+{
+    HttpRequest httpRequest("https://httpbun.com/delay/3");
+
+    auto response = httpRequest
+                    .setTimeout(10)
+                    .setDeadline(std::chrono::steady_clock::now() + std::chrono::milliseconds(500))
+                    .send()
+                    .get();
+
+    ASSERT_FALSE(response.succeed) << "HTTP Request is not failed";
+    ASSERT_EQ(response.errorMessage, curl_easy_strerror(CURLE_OPERATION_TIMEDOUT)) << "HTTP Error Message is invalid";
+}
+
+TEST(TimeoutTest, TimeoutsMustBeAddedToCurlCommand)
+{
+    HttpRequest httpRequest("https://httpbun.com/get");
+
+    httpRequest.setTimeout(std::chrono::milliseconds(1500)).setConnectTimeout(std::chrono::milliseconds(250));
+
+    ASSERT_EQ(httpRequest.toCurlCommand(), "curl -X GET --max-time 1.5 --connect-timeout 0.25 \"https://httpbun.com/get\"") << "Curl command is invalid";
+}
+
+TEST(CancellationTest, RequestCanBeCancelled)
+{
+    CancellationToken token;
+
+    HttpRequest httpRequest("https://httpbun.com/delay/5");
+
+    const auto start = std::chrono::steady_clock::now();
+
+    auto future = httpRequest.setCancellationToken(token).send();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    token.cancel();
+
+    auto response = future.get();
+
+    ASSERT_FALSE(response.succeed) << "HTTP Request is not failed";
+    ASSERT_EQ(response.errorMessage, "Request is cancelled") << "HTTP Error Message is invalid";
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(3)) << "Request is not aborted";
+}
+
+TEST(CancellationTest, RequestsOnHttpClientCanBeCancelled)
+{
+    HttpClient client;
+
+    CancellationToken token;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    auto first = client.send(HttpRequest("https://httpbun.com/delay/5").setCancellationToken(token));
+    auto second = client.send(HttpRequest("https://httpbun.com/delay/5").setCancellationToken(token));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    token.cancel();
+
+    auto firstResponse = first.get();
+    auto secondResponse = second.get();
+
+    ASSERT_EQ(firstResponse.errorMessage, "Request is cancelled") << "HTTP Error Message is invalid";
+    ASSERT_EQ(secondResponse.errorMessage, "Request is cancelled") << "HTTP Error Message is invalid";
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1)) << "Requests are not aborted immediately";
+}
+
+TEST(CancellationTest, CancelledRequestMustNotBeSent)
+{
+    CancellationToken token;
+
+    token.cancel();
+
+    auto response = HttpRequest("https://httpbun.com/get").setCancellationToken(token).send().get();
+
+    ASSERT_FALSE(response.succeed) << "HTTP Request is not failed";
+    ASSERT_EQ(response.statusCode, 0) << "HTTP Status Code is not 0";
+    ASSERT_EQ(response.errorMessage, "Request is cancelled") << "HTTP Error Message is invalid";
+}
+
+TEST(HedgingTest, HedgedAttemptCanWin)
+{
+    HttpClient client;
+
+    auto policy = HedgingPolicy().setDelay(std::chrono::milliseconds(200)).addAlternateUrl("https://httpbun.com/get");
+
+    const auto start = std::chrono::steady_clock::now();
+
+    auto response = client.send(HttpRequest("https://httpbun.com/delay/5").setHedging(policy)).get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+    ASSERT_EQ(response.attempt, 1) << "Hedged attempt did not win";
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(4)) << "Slow attempt is waited for";
+}
+
+TEST(HedgingTest, FastRequestMustNotBeHedged)
+{
+    HttpClient client;
+
+    auto policy = HedgingPolicy().setDelay(std::chrono::seconds(5)).addAlternateUrl("https://httpbun.com/status/500");
+
+    auto response = client.send(HttpRequest("https://httpbun.com/get").setHedging(policy)).get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.attempt, 0) << "Original attempt did not win";
+    ASSERT_EQ(policy.getLatencies().count(), 1) << "Latency is not recorded";
+}
+
+TEST(HedgingTest, ServerErrorMustBeHedgedImmediately)
+{
+    HttpClient client;
+
+    auto policy = HedgingPolicy().setDelay(std::chrono::seconds(5)).addAlternateUrl("https://httpbun.com/get");
+
+    const auto start = std::chrono::steady_clock::now();
+
+    auto response = client.send(HttpRequest("https://httpbun.com/status/503").setHedging(policy)).get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.attempt, 1) << "Hedged attempt did not win";
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(4)) << "Hedge delay is waited for";
+}
+
+TEST(HedgingTest, ClientErrorMustNotBeHedged)
+{
+    HttpClient client;
+
+    auto policy = HedgingPolicy().setDelay(std::chrono::seconds(5)).addAlternateUrl("https://httpbun.com/get");
+
+    auto response = client.send(HttpRequest("https://httpbun.com/status/404").setHedging(policy)).get();
+
+    ASSERT_FALSE(response.succeed) << "HTTP Request is not failed";
+    ASSERT_EQ(response.statusCode, 404) << "HTTP Status Code is not 404";
+    ASSERT_EQ(response.attempt, 0) << "Client error is hedged";
+}
+
+TEST(RetryTest, FailedRequestCanBeRetried)
+{
+    auto policy = RetryPolicy().setMaxAttempts(3).setBackoff(std::chrono::milliseconds(10), std::chrono::milliseconds(50));
+
+    HttpRequest httpRequest("https://httpbun.com/status/503");
+
+    auto response = httpRequest.setRetryPolicy(policy).send().get();
+
+    ASSERT_FALSE(response.succeed) << "HTTP Request is not failed";
+    ASSERT_EQ(response.statusCode, 503) << "HTTP Status Code is not 503";
+    ASSERT_EQ(response.attempt, 2) << "HTTP Request is not retried";
+}
+
+TEST(RetryTest, NonIdempotentRequestMustNotBeRetried)
+{
+    auto policy = RetryPolicy().setMaxAttempts(3).setBackoff(std::chrono::milliseconds(10), std::chrono::milliseconds(50));
+
+    HttpRequest httpRequest("https://httpbun.com/status/503");
+
+    auto response = httpRequest.setMethod(HttpMethod::POST).setRetryPolicy(policy).send().get();
+
+    ASSERT_EQ(response.statusCode, 503) << "HTTP Status Code is not 503";
+    ASSERT_EQ(response.attempt, 0) << "POST request is retried";
+}
+
+TEST(RetryTest, HugeRetryAfterMustNotBeWaited)
+{
+    auto policy = RetryPolicy().setMaxAttempts(3).setBackoff(std::chrono::milliseconds(10), std::chrono::milliseconds(50));
+
+    HttpRequest httpRequest("https://httpbun.com/mix/s=503/h=Retry-After:99999999999999999999999999");
+
+    auto response = httpRequest.setRetryPolicy(policy).send().get();
+
+    ASSERT_EQ(response.statusCode, 503) << "HTTP Status Code is not 503";
+    ASSERT_EQ(response.attempt, 0) << "Request is retried although Retry-After is longer than allowed";
+}
+
+TEST(RetryTest, RetriesAreLimitedByBudget)
+{
+    auto budget = std::make_shared<RetryBudget>(0, 0, 1);
+
+    auto policy = RetryPolicy().setMaxAttempts(5).setBackoff(std::chrono::milliseconds(10), std::chrono::milliseconds(50)).setBudget(budget);
+
+    HttpRequest httpRequest("https://httpbun.com/status/500");
+
+    auto response = httpRequest.setRetryPolicy(policy).send().get();
+
+    ASSERT_EQ(response.attempt, 1) << "Retry budget is not applied";
+    ASSERT_LT(budget->available(), 1) << "Retry budget is not used";
+}
+
+TEST(RetryTest, HttpClientCanRetryRequests)
+{
+    HttpClient client;
+
+    client.setRetryPolicy(RetryPolicy().setMaxAttempts(2).setBackoff(std::chrono::milliseconds(10), std::chrono::milliseconds(50)));
+
+    auto failed = client.send(HttpRequest("https://httpbun.com/status/502")).get();
+    auto succeed = client.send(HttpRequest("https://httpbun.com/get")).get();
+
+    ASSERT_EQ(failed.statusCode, 502) << "HTTP Status Code is not 502";
+    ASSERT_EQ(failed.attempt, 1) << "HTTP Request is not retried";
+    ASSERT_TRUE(succeed.succeed) << "HTTP Request failed";
+    ASSERT_EQ(succeed.attempt, 0) << "Successful HTTP Request is retried";
+}
+
 TEST(UserAgentTest, UserAgentCanBeSet)
 {
     HttpRequest httpRequest("https://httpbun.com/get");
@@ -841,22 +1066,1052 @@ TEST(CurlCommandTest, CurlCommandCanBeGet)
     ASSERT_EQ(response.toCurlCommand(), "curl -X POST -H \"Content-Type: application/json\" -A \"Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36 Edg/124.0.0.0\" --max-time 3 --limit-rate 10240 --data '{\"param1\": 7, \"param2\": \"test\"}' \"https://httpbun.com/post\"") << "Curl command is invalid";
 }
 
-TEST(StreamData, ResponseCanBeStreamedByOnDataReceivedCallback)
+TEST(CompressionTest, CompressedResponseMustBeDecoded)
 {
-    HttpRequest httpRequest("https://httpbun.com/bytes/5000");
+    HttpRequest httpRequest("https://httpbun.com/get");
 
-    httpRequest.onDataReceived([&](const unsigned char* chunk, const size_t dataLength)
+    auto response = httpRequest.acceptCompression().send().get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+    ASSERT_EQ(response.decodedBytes, static_cast<long long>(response.textData.size())) << "Decoded bytes are invalid";
+    ASSERT_GT(response.wireBytes, 0) << "Wire bytes are invalid";
+    ASSERT_LE(response.wireBytes, response.decodedBytes) << "Wire bytes are more than decoded bytes";
+
+    auto data = json::parse(response.textData);
+
+    ASSERT_NE(data["headers"]["Accept-Encoding"].get<std::string>().find("gzip"), std::string::npos) << "Accept-Encoding header is not sent";
+}
+
+TEST(CompressionTest, CompressedResponseCanBeStreamed)
+{
+    HttpRequest httpRequest("https://httpbun.com/get");
+
+    size_t streamedBytes = 0;
+
+    auto response = httpRequest
+                    .acceptCompression("gzip")
+                    .onDataReceived([&streamedBytes](const unsigned char*, const size_t dataLength)
+                    {
+                        streamedBytes += dataLength;
+                    })
+                    .send()
+                    .get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_TRUE(response.textData.empty()) << "Streamed data is buffered";
+    ASSERT_EQ(response.decodedBytes, static_cast<long long>(streamedBytes)) << "Decoded bytes are invalid";
+}
+
+TEST(CompressionTest, CompressionMustBeAddedToCurlCommand)
+{
+    HttpRequest httpRequest("https://httpbun.com/get");
+
+    ASSERT_EQ(httpRequest.acceptCompression().toCurlCommand(), "curl -X GET --compressed \"https://httpbun.com/get\"") << "Curl command is invalid";
+    ASSERT_EQ(httpRequest.acceptCompression("br").toCurlCommand(), "curl -X GET --compressed -H \"Accept-Encoding: br\" \"https://httpbun.com/get\"") << "Curl command is invalid";
+}
+
+TEST(CacheTest, FreshResponseMustBeServedFromCache)
+{
+    auto cache = std::make_shared<HttpCache>();
+
+    HttpRequest firstRequest("https://httpbun.com/cache/60");
+
+    auto firstResponse = firstRequest.setCache(cache).send().get();
+
+    ASSERT_TRUE(firstResponse.succeed) << "HTTP Request failed";
+    ASSERT_EQ(firstResponse.cacheStatus, CacheStatus::MISS) << "First response is not received from the server";
+
+    HttpRequest secondRequest("https://httpbun.com/cache/60");
+
+    auto future = secondRequest.setCache(cache).send();
+
+    ASSERT_EQ(future.wait_for(std::chrono::seconds(0)), std::future_status::ready) << "Cache hit is not completed at once";
+
+    auto secondResponse = future.get();
+
+    ASSERT_TRUE(secondResponse.succeed) << "HTTP Request failed";
+    ASSERT_EQ(secondResponse.statusCode, 200) << "HTTP Status Code is not 200";
+    ASSERT_EQ(secondResponse.cacheStatus, CacheStatus::HIT) << "Second response is not served from the cache";
+    ASSERT_EQ(secondResponse.textData, firstResponse.textData) << "Cached data is invalid";
+    ASSERT_EQ(cache->statistics().hits, 1) << "Cache hit is not counted";
+}
+
+TEST(CacheTest, NoStoreRequestMustNotUseCache)
+{
+    auto cache = std::make_shared<HttpCache>();
+
+    HttpRequest firstRequest("https://httpbun.com/cache/60");
+
+    firstRequest.setCache(cache).send().get();
+
+    HttpRequest secondRequest("https://httpbun.com/cache/60");
+
+    auto response = secondRequest
+                    .setCache(cache)
+                    .addHeader("Cache-Control", "no-store")
+                    .send()
+                    .get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.cacheStatus, CacheStatus::NONE) << "Response is served from the cache";
+}
+
+TEST(CacheTest, ConditionalHeaderOfCallerMustNotBeRevalidatedByCache)
+{
+    auto cache = std::make_shared<HttpCache>();
+
+    HttpRequest firstRequest("https://httpbun.com/etag/abc");
+
+    firstRequest.setCache(cache).send().get();
+
+    HttpRequest secondRequest("https://httpbun.com/etag/abc");
+
+    auto response = secondRequest
+                    .setCache(cache)
+                    .addHeader("if-none-match", "\"abc\"")
+                    .send()
+                    .get();
+
+    ASSERT_EQ(response.statusCode, 304) << "304 response is not returned to the caller";
+    ASSERT_NE(response.cacheStatus, CacheStatus::REVALIDATED) << "Conditional header of the caller is used to revalidate the stored response";
+}
+
+TEST(CacheTest, RequestWithPayloadMustNotBeCached)
+{
+    auto cache = std::make_shared<HttpCache>();
+
+    HttpRequest httpRequest("https://httpbun.com/post");
+
+    auto response = httpRequest
+                    .setCache(cache)
+                    .setMethod(HttpMethod::POST)
+                    .setPayload("param1=7&param2=test")
+                    .send()
+                    .get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.cacheStatus, CacheStatus::NONE) << "Response is cached";
+    ASSERT_EQ(cache->statistics().stores, 0) << "Response is stored";
+}
+
+TEST(SharedBodyTest, ResponseCanBeReturnedAsSharedBuffer)
+{
+    HttpRequest httpRequest("https://httpbun.com/bytes/100000");
+
+    auto response = httpRequest.returnAsShared().send().get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+    ASSERT_TRUE(response.textData.empty()) << "Body is copied into textData";
+    ASSERT_TRUE(response.binaryData.empty()) << "Body is copied into binaryData";
+    ASSERT_EQ(response.sharedData.size(), 100000) << "Shared body size is invalid";
+    ASSERT_EQ(response.sharedData.view().size(), 100000) << "Shared body view is invalid";
+
+    size_t chunkBytes = 0;
+
+    for (const auto chunk : response.sharedData.chunks())
     {
-        ASSERT_TRUE(dataLength > 0) << "Binary data length is invalid";
-    });
+        chunkBytes += chunk.size();
+    }
+
+    ASSERT_EQ(chunkBytes, 100000) << "Shared body chunks are invalid";
+}
+
+TEST(SharedBodyTest, SharedBufferMustNotCopyBodyWhenCopied)
+{
+    SharedBuffer buffer(std::vector<std::string>{"first ", "second ", "third"});
+
+    auto copy = buffer;
+
+    ASSERT_EQ(copy.chunks().size(), 3) << "Chunks are invalid";
+    ASSERT_EQ(copy.view(), "first second third") << "Joined view is invalid";
+    ASSERT_EQ(copy.data(), buffer.data()) << "Body is copied";
+    ASSERT_EQ(buffer.useCount(), 2) << "Reference count is invalid";
+}
+
+TEST(CacheTest, SharedResponseMustBeServedWithoutCopy)
+{
+    auto cache = std::make_shared<HttpCache>();
+
+    HttpRequest firstRequest("https://httpbun.com/cache/60");
+
+    auto firstResponse = firstRequest.setCache(cache).returnAsShared().send().get();
+
+    HttpRequest secondRequest("https://httpbun.com/cache/60");
+
+    auto secondResponse = secondRequest.setCache(cache).returnAsShared().send().get();
+
+    ASSERT_TRUE(secondResponse.succeed) << "HTTP Request failed";
+    ASSERT_EQ(secondResponse.cacheStatus, CacheStatus::HIT) << "Response is not served from the cache";
+    ASSERT_EQ(secondResponse.sharedData.data(), firstResponse.sharedData.data()) << "Cached body is copied";
+}
+
+TEST(CoalescingTest, IdenticalRequestsMustShareTransfer)
+{
+    auto coalescer = std::make_shared<RequestCoalescer>();
+
+    std::vector<HttpRequest> requests(5, HttpRequest("https://httpbun.com/delay/1"));
+
+    std::vector<std::future<HttpResult>> futures;
+
+    for (auto& request : requests)
+    {
+        futures.push_back(request.setCoalescer(coalescer).send());
+    }
+
+    std::set<const char*> buffers;
+
+    for (auto& future : futures)
+    {
+        auto response = future.get();
+
+        ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+        ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+        ASSERT_TRUE(response.textData.empty()) << "Body is copied into textData";
+        ASSERT_FALSE(response.sharedData.empty()) << "Shared body is empty";
+
+        buffers.insert(response.sharedData.data());
+    }
+
+    ASSERT_EQ(buffers.size(), 1) << "Body is not shared";
+    ASSERT_EQ(coalescer->coalescedCount(), 4) << "Requests are not coalesced";
+    ASSERT_EQ(coalescer->inFlight(), 0) << "Transfer is not completed";
+}
+
+TEST(CoalescingTest, RequestsWithDifferentKeyHeadersMustNotBeCoalesced)
+{
+    auto coalescer = std::make_shared<RequestCoalescer>();
+
+    HttpRequest firstRequest("https://httpbun.com/delay/1");
+    HttpRequest secondRequest("https://httpbun.com/delay/1");
+
+    auto firstFuture = firstRequest.setCoalescer(coalescer).addHeader("Authorization", "Bearer first").send();
+    auto secondFuture = secondRequest.setCoalescer(coalescer).addHeader("Authorization", "Bearer second").send();
+
+    auto firstResponse = firstFuture.get();
+    auto secondResponse = secondFuture.get();
+
+    ASSERT_TRUE(firstResponse.succeed) << "HTTP Request failed";
+    ASSERT_TRUE(secondResponse.succeed) << "HTTP Request failed";
+    ASSERT_FALSE(firstResponse.coalesced) << "Request is coalesced";
+    ASSERT_FALSE(secondResponse.coalesced) << "Request is coalesced";
+    ASSERT_EQ(coalescer->coalescedCount(), 0) << "Requests are coalesced";
+}
+
+#ifdef LIBCPP_HTTP_CLIENT_WITH_ZLIB
+TEST(CompressionTest, PayloadCanBeCompressedWithGzip)
+{
+    HttpRequest httpRequest("https://httpbun.com/post");
 
     auto response = httpRequest
-                    .returnAsBinary()
+                    .setMethod(HttpMethod::POST)
+                    .setPayload(R"({"param1": 7, "param2": "test"})")
+                    .addHeader("Content-Type", "application/json")
+                    .compressPayload(CompressionCodec::GZIP)
                     .send()
                     .get();
 
     ASSERT_TRUE(response.succeed) << "HTTP Request failed";
     ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+
+    auto data = json::parse(response.textData);
+
+    ASSERT_EQ(data["headers"]["Content-Encoding"], "gzip") << "Content-Encoding header is invalid";
+}
+#else
+TEST(CompressionTest, GzipPayloadCompressionMustFailIfNotEnabled)
+{
+    HttpRequest httpRequest("https://httpbun.com/post");
+
+    auto response = httpRequest
+                    .setMethod(HttpMethod::POST)
+                    .setPayload(R"({"param1": 7, "param2": "test"})")
+                    .compressPayload(CompressionCodec::GZIP)
+                    .send()
+                    .get();
+
+    ASSERT_FALSE(response.succeed) << "HTTP Request is not failed";
+    ASSERT_EQ(response.statusCode, 0) << "HTTP Status Code is not 0";
+    ASSERT_EQ(response.errorMessage, "gzip payload compression is not enabled (define LIBCPP_HTTP_CLIENT_WITH_ZLIB and link zlib)") << "HTTP Error Message is invalid";
+}
+#endif
+
+#ifdef LIBCPP_HTTP_CLIENT_WITH_ZSTD
+TEST(CompressionTest, PayloadStreamCanBeCompressedWithZstdDictionary)
+{
+    auto dictionary = std::make_shared<ZstdDictionary>(R"({"param1": 7, "param2": "test"}{"param1": 8, "param2": "test"})");
+
+    ASSERT_TRUE(dictionary->isValid()) << "Dictionary is not loaded";
+
+    std::istringstream payload(R"({"param1": 9, "param2": "test"})");
+
+    HttpRequest httpRequest("https://httpbun.com/post");
+
+    auto response = httpRequest
+                    .setMethod(HttpMethod::POST)
+                    .setPayloadStream(payload)
+                    .compressPayload(dictionary)
+                    .send()
+                    .get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+
+    auto data = json::parse(response.textData);
+
+    ASSERT_EQ(data["headers"]["Content-Encoding"], "zstd") << "Content-Encoding header is invalid";
+}
+#endif
+
+TEST(StreamData, ResponseCanBeStreamedByOnDataReceivedCallback)
+{
+    HttpRequest httpRequest("https://httpbun.com/bytes/5000");
+
+    httpRequest.onDataReceived([&](const unsigned char* chunk, const size_t dataLength)
+    {
+        ASSERT_TRUE(dataLength > 0) << "Binary data length is invalid";
+    });
+
+    auto response = httpRequest
+                    .returnAsBinary()
+                    .send()
+                    .get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+}
+
+TEST(ConnectionPoolTest, ConnectionsMustBeReusedForTheSameHost)
+{
+    auto pool = std::make_shared<ConnectionPool>();
+
+    HttpRequest httpRequest1("https://httpbun.com/get");
+    HttpRequest httpRequest2("https://httpbun.com/get");
+
+    auto response1 = httpRequest1.setConnectionPool(pool).send().get();
+
+    ASSERT_TRUE(response1.succeed) << "HTTP Request failed";
+    ASSERT_EQ(pool->idleConnectionCount(), 1) << "Connection is not returned to the pool";
+
+    auto response2 = httpRequest2.setConnectionPool(pool).send().get();
+
+    ASSERT_TRUE(response2.succeed) << "HTTP Request failed";
+    ASSERT_EQ(pool->idleConnectionCount(), 1) << "Pooled connection is not reused";
+}
+
+TEST(ConnectionPoolTest, IdleConnectionsMustBeLimitedPerHost)
+{
+    auto pool = std::make_shared<ConnectionPool>();
+
+    pool->setMaxIdleConnectionsPerHost(0);
+
+    HttpRequest httpRequest("https://httpbun.com/get");
+
+    auto response = httpRequest.setConnectionPool(pool).send().get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(pool->idleConnectionCount(), 0) << "Idle connection limit is exceeded";
+}
+
+TEST(HttpClientTest, MultipleRequestsMustBeCompletedSuccessfullyOnTheEventLoop)
+{
+    HttpClient client;
+
+    std::vector<std::future<HttpResult>> futures;
+
+    for (int i = 0; i < 10; i++)
+    {
+        HttpRequest httpRequest("https://httpbun.com/get");
+
+        futures.push_back(client.send(httpRequest.setQueryString("param1=" + std::to_string(i))));
+    }
+
+    for (int i = 0; i < 10; i++)
+    {
+        auto response = futures[i].get();
+
+        ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+        ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+        ASSERT_TRUE(response.errorMessage.empty()) << "HTTP Error Message is not empty";
+
+        auto data = json::parse(response.textData);
+
+        ASSERT_EQ(data["args"]["param1"], std::to_string(i)) << "Querystring is invalid";
+    }
+}
+
+TEST(HttpClientTest, HttpPostRequestMustBeCompletedSuccessfullyOnTheEventLoop)
+{
+    HttpClient client(2);
+
+    HttpRequest httpRequest("https://httpbun.com/post");
+
+    httpRequest
+        .setMethod(HttpMethod::POST)
+        .setPayload("param1=7&param2=test");
+
+    auto response = client.send(httpRequest).get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+
+    auto data = json::parse(response.textData);
+
+    ASSERT_EQ(data["method"], "POST") << "HTTP Method is invalid";
+    ASSERT_EQ(data["form"]["param1"], "7") << "Payload is invalid";
+}
+
+TEST(HttpClientTest, CallbackMustBeCalledWithTheResult)
+{
+    HttpClient client;
+
+    std::promise<HttpResult> completed;
+
+    client.send(HttpRequest("https://httpbun.com/get"), [&completed](HttpResult&& result)
+    {
+        completed.set_value(std::move(result));
+    });
+
+    auto response = completed.get_future().get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+}
+
+TEST(HttpClientTest, CallbackOfHttpRequestMustBeCalledOnTheSharedClient)
+{
+    std::promise<HttpResult> completed;
+
+    HttpRequest("https://httpbun.com/get").send([&completed](HttpResult&& result)
+    {
+        completed.set_value(std::move(result));
+    });
+
+    auto response = completed.get_future().get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+}
+
+TEST(HttpClientTest, BatchResultsMustBeReturnedInCompletionOrder)
+{
+    HttpClient client;
+
+    std::vector<HttpRequest> requests;
+
+    requests.emplace_back("https://httpbun.com/delay/2");
+    requests.emplace_back("https://httpbun.com/get");
+
+    auto batch = client.sendAll(std::move(requests));
+
+    std::vector<size_t> order;
+
+    while (auto completed = batch.next())
+    {
+        ASSERT_TRUE(completed->result.succeed) << "HTTP Request failed";
+
+        order.push_back(completed->index);
+    }
+
+    ASSERT_EQ(batch.size(), 2) << "Batch size is invalid";
+    ASSERT_EQ(batch.remaining(), 0) << "Remaining result count is not 0";
+    ASSERT_EQ(order, std::vector<size_t>({1, 0})) << "Results are not in completion order";
+}
+
+TEST(HttpClientTest, WhenAllMustReturnResultsInRequestOrder)
+{
+    HttpClient client;
+
+    std::vector<HttpRequest> requests;
+
+    requests.emplace_back("https://httpbun.com/delay/1");
+    requests.emplace_back("https://httpbun.com/status/404");
+
+    auto results = client.whenAll(std::move(requests)).get();
+
+    ASSERT_EQ(results.size(), 2) << "Result count is invalid";
+    ASSERT_EQ(results[0].statusCode, 200) << "HTTP Status Code is not 200";
+    ASSERT_EQ(results[1].statusCode, 404) << "HTTP Status Code is not 404";
+}
+
+TEST(HttpClientTest, WhenAnyMustReturnTheFirstSuccessfulResult)
+{
+    HttpClient client;
+
+    std::vector<HttpRequest> requests;
+
+    requests.emplace_back("https://httpbun.com/status/500");
+    requests.emplace_back("https://httpbun.com/get");
+
+    auto completed = client.whenAny(std::move(requests)).get();
+
+    ASSERT_TRUE(completed.result.succeed) << "HTTP Request failed";
+    ASSERT_EQ(completed.index, 1) << "Index of the successful request is invalid";
+}
+
+TEST(ExecutorTest, RequestsMustBeCompletedSuccessfullyOnThreadPoolExecutor)
+{
+    ThreadPoolExecutor executor(2);
+
+    HttpRequest httpRequest1("https://httpbun.com/get");
+    HttpRequest httpRequest2("https://httpbun.com/get");
+    HttpRequest httpRequest3("https://httpbun.com/get");
+
+    auto future1 = httpRequest1.setQueryString("param1=1").send(executor);
+    auto future2 = httpRequest2.setQueryString("param1=2").send(executor);
+    auto future3 = httpRequest3.setQueryString("param1=3").send(executor);
+
+    auto response1 = future1.get();
+    auto response2 = future2.get();
+    auto response3 = future3.get();
+
+    ASSERT_TRUE(response1.succeed) << "HTTP Request failed";
+    ASSERT_TRUE(response2.succeed) << "HTTP Request failed";
+    ASSERT_TRUE(response3.succeed) << "HTTP Request failed";
+
+    ASSERT_EQ(json::parse(response1.textData)["args"]["param1"], "1") << "Querystring is invalid";
+    ASSERT_EQ(json::parse(response2.textData)["args"]["param1"], "2") << "Querystring is invalid";
+    ASSERT_EQ(json::parse(response3.textData)["args"]["param1"], "3") << "Querystring is invalid";
+}
+
+TEST(ExecutorTest, RequestMustFailWhenTheExecutorQueueIsFull)
+{
+    ThreadPoolExecutor executor(1, 1, QueueFullPolicy::FAIL);
+
+    std::vector<HttpRequest> httpRequests(5, HttpRequest("https://httpbun.com/delay/1"));
+    std::vector<std::future<HttpResult>> futures;
+
+    for (auto& httpRequest : httpRequests)
+    {
+        futures.push_back(httpRequest.send(executor));
+    }
+
+    int rejectedCount = 0;
+
+    for (auto& future : futures)
+    {
+        auto response = future.get();
+
+        if (!response.succeed && response.statusCode == 0)
+        {
+            ASSERT_FALSE(response.errorMessage.empty()) << "HTTP Error Message is empty";
+
+            rejectedCount++;
+        }
+    }
+
+    ASSERT_GE(rejectedCount, 3) << "Requests exceeding the queue capacity are not rejected";
+}
+
+TEST(HttpVersionTest, HttpVersionCanBeSet)
+{
+    HttpRequest httpRequest("https://httpbun.com/get");
+
+    auto response = httpRequest
+                    .setHttpVersion(HttpVersion::HTTP_2)
+                    .send()
+                    .get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+    ASSERT_FALSE(response.textData.empty()) << "HTTP Response is empty";
+    ASSERT_TRUE(response.errorMessage.empty()) << "HTTP Error Message is not empty";
+}
+
+TEST(HttpVersionTest, HttpVersionMustBeAddedToCurlCommand)
+{
+    HttpRequest httpRequest("https://httpbun.com/get");
+
+    httpRequest.setHttpVersion(HttpVersion::HTTP_1_1);
+
+    ASSERT_EQ(httpRequest.toCurlCommand(), "curl -X GET --http1.1 \"https://httpbun.com/get\"") << "Curl command is invalid";
+}
+
+TEST(HttpVersionTest, Http2RequestsMustBeMultiplexedByHttpClient)
+{
+    HttpClient client;
+
+    client.setMaxStreamsPerConnection(10);
+
+    std::vector<std::future<HttpResult>> futures;
+
+    for (int i = 0; i < 5; i++)
+    {
+        HttpRequest httpRequest("https://httpbun.com/get");
+
+        futures.push_back(client.send(httpRequest.setHttpVersion(HttpVersion::HTTP_2_TLS)));
+    }
+
+    for (auto& future : futures)
+    {
+        auto response = future.get();
+
+        ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+        ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+    }
+}
+
+TEST(ResponseBufferTest, ResponseCanBeWrittenIntoCallerProvidedBuffer)
+{
+    std::vector<unsigned char> buffer(1024);
+
+    HttpRequest httpRequest("https://httpbun.com/bytes/100");
+
+    auto response = httpRequest
+                    .setResponseBuffer(buffer.data(), buffer.size())
+                    .send()
+                    .get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+    ASSERT_EQ(response.bytesWritten, 100) << "Written data length is invalid";
+    ASSERT_TRUE(response.textData.empty()) << "Text data is not empty";
+    ASSERT_TRUE(response.binaryData.empty()) << "Binary data is not empty";
+}
+
+TEST(ResponseBufferTest, AnErrorMessageShouldBeReturnedIfTheResponseDoesNotFitIntoTheBuffer)
+{
+    std::vector<unsigned char> buffer(10);
+
+    HttpRequest httpRequest("https://httpbun.com/bytes/100");
+
+    auto response = httpRequest
+                    .setResponseBuffer(buffer.data(), buffer.size())
+                    .send()
+                    .get();
+
+    ASSERT_FALSE(response.succeed) << "HTTP Request is not failed";
+    ASSERT_FALSE(response.errorMessage.empty()) << "HTTP Error Message is empty";
+}
+
+TEST(ResponseBufferPoolTest, ResponseBuffersMustBeReturnedToThePoolAndReused)
+{
+    auto pool = std::make_shared<ResponseBufferPool>();
+
+    {
+        HttpRequest httpRequest("https://httpbun.com/bytes/5000");
+
+        auto response = httpRequest
+                        .returnAsBinary()
+                        .setResponseBufferPool(pool)
+                        .send()
+                        .get();
+
+        ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+        ASSERT_EQ(response.binaryData.size(), 5000) << "Binary data length is invalid";
+    }
+
+    ASSERT_EQ(pool->statistics().returned, 1) << "Buffer is not returned to the pool";
+    ASSERT_GT(pool->statistics().bytesHeld, 0) << "Buffer is not kept in the pool";
+
+    HttpRequest httpRequest("https://httpbun.com/bytes/5000");
+
+    auto response = httpRequest
+                    .returnAsBinary()
+                    .setResponseBufferPool(pool)
+                    .send()
+                    .get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.binaryData.size(), 5000) << "Binary data length is invalid";
+    ASSERT_EQ(pool->statistics().hits, 1) << "Pooled buffer is not reused";
+
+    response.releaseBuffers();
+
+    ASSERT_TRUE(response.binaryData.empty()) << "Binary data is not released";
+    ASSERT_EQ(pool->statistics().returned, 2) << "Buffer is not returned to the pool";
+}
+
+TEST(ResponseHeadersTest, ResponseHeadersCanBeReadCaseInsensitively)
+{
+    HttpRequest httpRequest("https://httpbun.com/response-headers?X-Custom-Header=value1");
+
+    auto response = httpRequest.send().get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_FALSE(response.headers.empty()) << "Response headers are empty";
+    ASSERT_EQ(response.headers.get("x-custom-header"), "value1") << "Response header is invalid";
+    ASSERT_EQ(response.headers.get("X-CUSTOM-HEADER"), "value1") << "Response header is invalid";
+    ASSERT_TRUE(response.headers.contains("Content-Type")) << "Content-Type header is missing";
+    ASSERT_FALSE(response.headers.contains("Not-Existing-Header")) << "Not existing header is found";
+    ASSERT_TRUE(response.headers.get("Not-Existing-Header").empty()) << "Not existing header is not empty";
+}
+
+TEST(ResponseHeadersTest, ResponseHeadersMustRemainValidWhenTheResultIsMovedOrCopied)
+{
+    HttpRequest httpRequest("https://httpbun.com/response-headers?X-Custom-Header=value1");
+
+    auto response = httpRequest.send().get();
+
+    ASSERT_EQ(response.headers.get("X-Custom-Header"), "value1") << "Response header is invalid";
+
+    auto copied = response;
+    auto moved = std::move(response);
+
+    ASSERT_EQ(copied.headers.get("X-Custom-Header"), "value1") << "Copied response header is invalid";
+    ASSERT_EQ(moved.headers.get("X-Custom-Header"), "value1") << "Moved response header is invalid";
+}
+
+TEST(PayloadStreamTest, PayloadCanBeStreamedFromAnInputStream)
+{
+    std::istringstream payload("param1=7&param2=test");
+
+    HttpRequest httpRequest("https://httpbun.com/post");
+
+    auto response = httpRequest
+                    .setMethod(HttpMethod::POST)
+                    .setPayloadStream(payload, 20)
+                    .send()
+                    .get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+
+    auto data = json::parse(response.textData);
+
+    ASSERT_EQ(data["form"]["param1"], "7") << "Payload is invalid";
+    ASSERT_EQ(data["form"]["param2"], "test") << "Payload is invalid";
+}
+
+TEST(PayloadStreamTest, PayloadOfUnknownSizeCanBeStreamedFromACallback)
+{
+    const std::string source = R"({"param1": 7, "param2": "test"})";
+
+    size_t position = 0;
+
+    HttpRequest httpRequest("https://httpbun.com/post");
+
+    auto response = httpRequest
+                    .setMethod(HttpMethod::POST)
+                    .addHeader("Content-Type", "application/json")
+                    .setPayloadStream([&](char* buffer, const size_t bufferSize)
+                    {
+                        const auto length = std::min<size_t>(std::min<size_t>(bufferSize, 4), source.size() - position);
+
+                        std::memcpy(buffer, source.data() + position, length);
+
+                        position += length;
+
+                        return length;
+                    })
+                    .send()
+                    .get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+
+    auto data = json::parse(response.textData);
+
+    ASSERT_EQ(data["json"]["param1"], 7) << "Payload is invalid";
+    ASSERT_EQ(data["json"]["param2"], "test") << "Payload is invalid";
+}
+
+TEST(PayloadStreamTest, PayloadCanBeMovedIntoTheRequest)
+{
+    std::string payload = "param1=7&param2=test";
+
+    HttpRequest httpRequest("https://httpbun.com/post");
+
+    auto response = httpRequest
+                    .setMethod(HttpMethod::POST)
+                    .setPayload(std::move(payload))
+                    .send()
+                    .get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+
+    auto data = json::parse(response.textData);
+
+    ASSERT_EQ(data["form"]["param1"], "7") << "Payload is invalid";
+}
+
+TEST(FileTransferTest, PayloadCanBeSentFromAFile)
+{
+    {
+        std::ofstream file("payload_test.txt", std::ios::binary);
+
+        file << "param1=7&param2=test";
+    }
+
+    HttpRequest httpRequest("https://httpbun.com/put");
+
+    auto response = httpRequest
+                    .setMethod(HttpMethod::PUT)
+                    .setPayloadFromFile("payload_test.txt")
+                    .send()
+                    .get();
+
+    std::remove("payload_test.txt");
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+
+    auto data = json::parse(response.textData);
+
+    ASSERT_EQ(data["method"], "PUT") << "HTTP Method is invalid";
+    ASSERT_EQ(data["form"]["param1"], "7") << "Payload is invalid";
+    ASSERT_EQ(data["form"]["param2"], "test") << "Payload is invalid";
+}
+
+TEST(FileTransferTest, AnErrorMessageShouldBeReturnedIfThePayloadFileDoesNotExist)
+{
+    HttpRequest httpRequest("https://httpbun.com/put");
+
+    auto response = httpRequest
+                    .setMethod(HttpMethod::PUT)
+                    .setPayloadFromFile("not_existing_payload_file.txt")
+                    .send()
+                    .get();
+
+    ASSERT_FALSE(response.succeed) << "HTTP Request is not failed";
+    ASSERT_EQ(response.statusCode, 0) << "HTTP Status Code is not 0";
+    ASSERT_FALSE(response.errorMessage.empty()) << "HTTP Error Message is empty";
+}
+
+TEST(FileTransferTest, ResponseCanBeDownloadedToAFile)
+{
+    HttpRequest httpRequest("https://httpbun.com/bytes/5000");
+
+    auto response = httpRequest
+                    .downloadToFile("download_test.bin", FileSyncPolicy::ON_COMPLETE)
+                    .send()
+                    .get();
+
+    std::ifstream file("download_test.bin", std::ios::binary | std::ios::ate);
+
+    const auto fileSize = file.tellg();
+
+    file.close();
+
+    std::remove("download_test.bin");
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_EQ(response.statusCode, 200) << "HTTP Status Code is not 200";
+    ASSERT_EQ(response.bytesWritten, 5000) << "Written data length is invalid";
+    ASSERT_EQ(fileSize, 5000) << "File size is invalid";
+    ASSERT_TRUE(response.binaryData.empty()) << "Binary data is not empty";
+}
+
+TEST(TimingsTest, TimingsCanBeCollected)
+{
+    HttpRequest httpRequest("https://httpbun.com/bytes/5000");
+
+    auto response = httpRequest.collectTimings().send().get();
+
+    const auto& timings = response.timings;
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_TRUE(timings.collected) << "Timings are not collected";
+    ASSERT_GT(timings.total.count(), 0) << "Total time is invalid";
+    ASSERT_LE(timings.nameLookup, timings.connect) << "Name lookup time is greater than connect time";
+    ASSERT_LE(timings.connect, timings.tlsHandshake) << "Connect time is greater than TLS handshake time";
+    ASSERT_LE(timings.startTransfer, timings.total) << "Start transfer time is greater than total time";
+    ASSERT_EQ(timings.downloadedBytes, 5000) << "Downloaded byte count is invalid";
+    ASSERT_NE(timings.httpVersion, HttpVersion::DEFAULT) << "HTTP version is not set";
+}
+
+TEST(TimingsTest, TimingsShouldNotBeCollectedByDefault)
+{
+    HttpRequest httpRequest("https://httpbun.com/get");
+
+    auto response = httpRequest.send().get();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_FALSE(response.timings.collected) << "Timings are collected";
+    ASSERT_EQ(response.timings.total.count(), 0) << "Total time is not 0";
+}
+
+TEST(TimingsTest, ReusedConnectionShouldBeReported)
+{
+    auto pool = std::make_shared<ConnectionPool>();
+
+    auto firstResponse = HttpRequest("https://httpbun.com/get").setConnectionPool(pool).collectTimings().send().get();
+    auto secondResponse = HttpRequest("https://httpbun.com/get").setConnectionPool(pool).collectTimings().send().get();
+
+    ASSERT_TRUE(firstResponse.succeed) << "HTTP Request failed";
+    ASSERT_TRUE(secondResponse.succeed) << "HTTP Request failed";
+    ASSERT_FALSE(firstResponse.timings.connectionReused) << "First connection is reported as reused";
+    ASSERT_TRUE(secondResponse.timings.connectionReused) << "Second connection is not reported as reused";
+}
+
+TEST(TimingsTest, FailedConnectionShouldNotBeReportedAsReused)
+{
+    auto response = HttpRequest("https://no-such-host.invalid").collectTimings().send().get();
+
+    ASSERT_FALSE(response.succeed) << "Request to an unresolvable host succeeded";
+    ASSERT_TRUE(response.timings.collected) << "Timings are not collected";
+    ASSERT_FALSE(response.timings.connectionReused) << "Failed connection is reported as reused";
+}
+
+TEST(MetricsTest, RequestsShouldBeRecordedByHostMethodAndStatusClass)
+{
+    auto metrics = std::make_shared<HttpMetrics>();
+
+    auto firstResponse = HttpRequest("https://httpbun.com/get").setMetrics(metrics).send().get();
+    auto secondResponse = HttpRequest("https://httpbun.com/status/404").setMetrics(metrics).send().get();
+
+    const auto snapshot = metrics->snapshot();
+
+    ASSERT_TRUE(firstResponse.succeed) << "HTTP Request failed";
+    ASSERT_EQ(secondResponse.statusCode, 404) << "HTTP Status Code is not 404";
+    ASSERT_EQ(snapshot.series.size(), 2) << "Series count is invalid";
+    ASSERT_EQ(snapshot.series[0].host, "httpbun.com") << "Host label is invalid";
+    ASSERT_EQ(snapshot.series[0].method, "GET") << "Method label is invalid";
+    ASSERT_EQ(snapshot.series[0].statusClass, "2xx") << "Status class label is invalid";
+    ASSERT_EQ(snapshot.series[0].latency.count, 1) << "Request count is invalid";
+    ASSERT_EQ(snapshot.series[1].statusClass, "4xx") << "Status class label is invalid";
+    ASSERT_EQ(snapshot.requestsInFlight, 0) << "In flight request count is not 0";
+    ASSERT_EQ(snapshot.connectionsOpened + snapshot.connectionsReused, 2) << "Connection count is invalid";
+    ASSERT_GT(snapshot.bytesReceived, 0) << "Received byte count is 0";
+}
+
+TEST(MetricsTest, TransferErrorsShouldBeRecordedByCurlCode)
+{
+    auto metrics = std::make_shared<HttpMetrics>();
+
+    auto response = HttpRequest("https://no-such-host.invalid").setMetrics(metrics).send().get();
+
+    const auto snapshot = metrics->snapshot();
+
+    ASSERT_FALSE(response.succeed) << "HTTP Request is not failed";
+    ASSERT_EQ(snapshot.errors.count(CURLE_COULDNT_RESOLVE_HOST), 1) << "Error is not recorded";
+    ASSERT_EQ(snapshot.series[0].statusClass, "none") << "Status class label is invalid";
+}
+
+TEST(MetricsTest, MetricsCanBeExportedInOpenMetricsFormat)
+{
+    auto metrics = std::make_shared<HttpMetrics>();
+
+    HttpClient client;
+
+    client.setMetrics(metrics);
+
+    auto response = client.send(HttpRequest("https://httpbun.com/get")).get();
+
+    const auto text = metrics->toOpenMetrics();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_NE(text.find("http_client_requests_total{host=\"httpbun.com\",method=\"GET\",status_class=\"2xx\"} 1"), std::string::npos) << "Request counter is not exported";
+    ASSERT_NE(text.find("http_client_request_duration_seconds_bucket{host=\"httpbun.com\",method=\"GET\",status_class=\"2xx\",le=\"+Inf\"} 1"), std::string::npos) << "Latency histogram is not exported";
+    ASSERT_NE(text.find("http_client_requests_in_flight 0"), std::string::npos) << "In flight gauge is not exported";
+    ASSERT_EQ(text.substr(text.size() - 6), "# EOF\n") << "Export is not terminated";
+}
+
+TEST(MetricsTest, LatencyHistogramPercentilesShouldBeAccurate)
+{
+    LatencyHistogram histogram;
+
+    for (int i = 1; i <= 1000; i++)
+    {
+        histogram.record(std::chrono::microseconds(i * 100));
+    }
+
+    const auto p50 = histogram.percentile(0.5).count();
+    const auto p99 = histogram.percentile(0.99).count();
+
+    ASSERT_EQ(histogram.count(), 1000) << "Recorded count is invalid";
+    ASSERT_NEAR(p50, 50000, 50000 / 8) << "p50 is invalid";
+    ASSERT_NEAR(p99, 99000, 99000 / 8) << "p99 is invalid";
+}
+
+TEST(DnsCacheTest, ResolveOverrideShouldBeUsedInsteadOfResolving)
+{
+    auto pool = std::make_shared<ConnectionPool>();
+
+    // Nothing listens on port 1, so the request fails while connecting instead of resolving
+    pool->addResolveOverride("libcpp-http-client.invalid", 1, "127.0.0.1");
+
+    auto response = HttpRequest("http://libcpp-http-client.invalid:1").setConnectionPool(pool).send().get();
+
+    ASSERT_FALSE(response.succeed) << "HTTP Request is not failed";
+    ASSERT_EQ(response.errorMessage, curl_easy_strerror(CURLE_COULDNT_CONNECT)) << "Resolve override is not used";
+}
+
+TEST(DnsCacheTest, RemovedResolveOverrideShouldNotBeUsed)
+{
+    auto pool = std::make_shared<ConnectionPool>();
+
+    pool->addResolveOverride("libcpp-http-client.invalid", 1, "127.0.0.1");
+
+    auto firstResponse = HttpRequest("http://libcpp-http-client.invalid:1").setConnectionPool(pool).send().get();
+
+    pool->removeResolveOverride("libcpp-http-client.invalid", 1);
+
+    auto secondResponse = HttpRequest("http://libcpp-http-client.invalid:1").setConnectionPool(pool).send().get();
+
+    ASSERT_EQ(firstResponse.errorMessage, curl_easy_strerror(CURLE_COULDNT_CONNECT)) << "Resolve override is not used";
+    ASSERT_EQ(secondResponse.errorMessage, curl_easy_strerror(CURLE_COULDNT_RESOLVE_HOST)) << "Removed resolve override is used";
+}
+
+TEST(DnsCacheTest, ResolveOverridesShouldBeAddedToCurlCommand)
+{
+    auto pool = std::make_shared<ConnectionPool>();
+
+    pool->addResolveOverride("api.myproject.com", 443, "10.0.0.1");
+
+    const auto command = HttpRequest("https://api.myproject.com").setConnectionPool(pool).toCurlCommand();
+
+    ASSERT_EQ(command, "curl -X GET --resolve 'api.myproject.com:443:10.0.0.1' \"https://api.myproject.com\"") << "Curl command is invalid";
+}
+
+TEST(DnsCacheTest, HostsCanBePrefetched)
+{
+    auto pool = std::make_shared<ConnectionPool>();
+
+    pool->setDnsCacheTimeout(300);
+
+    const auto resolved = pool->prefetchHosts({"https://httpbun.com", "https://libcpp-http-client.invalid"});
+
+    auto response = HttpRequest("https://httpbun.com/get").setConnectionPool(pool).collectTimings().send().get();
+
+    ASSERT_EQ(resolved, 1) << "Resolved host count is invalid";
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+}
+
+TEST(TlsSessionTest, NewConnectionsShouldWorkWithTheSharedTlsSessionCache)
+{
+    // Idle connections are not kept, so every request opens a new connection
+    auto pool = std::make_shared<ConnectionPool>(0);
+
+    auto firstResponse = HttpRequest("https://httpbun.com/get").setConnectionPool(pool).collectTimings().send().get();
+    auto secondResponse = HttpRequest("https://httpbun.com/get").setConnectionPool(pool).collectTimings().send().get();
+
+    ASSERT_TRUE(firstResponse.succeed) << "HTTP Request failed";
+    ASSERT_TRUE(secondResponse.succeed) << "HTTP Request failed";
+    ASSERT_FALSE(secondResponse.timings.connectionReused) << "Connection is reused";
+}
+
+TEST(TlsSessionTest, TlsSessionsCanBeExportedAndImported)
+{
+    if (!ConnectionPool::supportsTlsSessionExport())
+    {
+        GTEST_SKIP() << "libcurl is built without TLS session export";
+    }
+
+    auto pool = std::make_shared<ConnectionPool>();
+
+    auto response = HttpRequest("https://httpbun.com/get").setConnectionPool(pool).send().get();
+
+    const auto sessions = pool->exportTlsSessions();
+
+    auto restartedPool = std::make_shared<ConnectionPool>();
+
+    ASSERT_TRUE(response.succeed) << "HTTP Request failed";
+    ASSERT_FALSE(sessions.empty()) << "No TLS session is exported";
+    ASSERT_EQ(restartedPool->importTlsSessions(sessions), sessions.size()) << "TLS sessions are not imported";
+}
+
+TEST(TlsSessionTest, ExpiredTlsSessionsShouldNotBeImported)
+{
+    TlsSession session;
+
+    session.key = "httpbun.com:443";
+    session.data = {1, 2, 3};
+    session.validUntil = std::chrono::system_clock::now() - std::chrono::seconds(1);
+
+    auto pool = std::make_shared<ConnectionPool>();
+
+    ASSERT_EQ(pool->importTlsSessions({session}), 0) << "Expired TLS session is imported";
 }
 
 int main(int argc, char** argv)